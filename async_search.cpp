@@ -0,0 +1,90 @@
+#include "async_search.h"
+
+#include <algorithm>
+#include <memory>
+
+AsyncSearchQueue::AsyncSearchQueue(const SearchServer& search_server, ThreadPool& executor, size_t max_batch_size)
+    : search_server_(search_server)
+    , executor_(executor)
+    , max_batch_size_(std::max<size_t>(1, max_batch_size))
+    , max_batches_in_flight_(executor.GetThreadCount())
+    , dispatcher_([this] { DispatchLoop(); }) {
+}
+
+AsyncSearchQueue::~AsyncSearchQueue() {
+    {
+        std::lock_guard guard(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    dispatcher_.join();
+
+    std::unique_lock lock(mutex_);
+    condition_.wait(lock, [this] { return batches_in_flight_ == 0; });
+}
+
+std::future<std::vector<Document>> AsyncSearchQueue::FindTopDocuments(std::string raw_query, DocumentStatus status) {
+    std::promise<std::vector<Document>> result;
+    auto future = result.get_future();
+    {
+        std::lock_guard guard(mutex_);
+        requests_.push_back({ std::move(raw_query), status, std::move(result) });
+    }
+    condition_.notify_all();
+    return future;
+}
+
+std::future<std::vector<Document>> AsyncSearchQueue::FindTopDocuments(std::string raw_query) {
+    return FindTopDocuments(std::move(raw_query), DocumentStatus::ACTUAL);
+}
+
+AsyncSearchStatistics AsyncSearchQueue::GetStatistics() const {
+    std::lock_guard guard(mutex_);
+    return statistics_;
+}
+
+void AsyncSearchQueue::DispatchLoop() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        condition_.wait(lock, [this] {
+            return (!requests_.empty() && batches_in_flight_ < max_batches_in_flight_) || (stop_ && requests_.empty());
+        });
+        if (requests_.empty()) {
+            return;
+        }
+
+        auto batch = std::make_shared<std::vector<Request>>();
+        const size_t batch_size = std::min(requests_.size(), max_batch_size_);
+        batch->reserve(batch_size);
+        for (size_t i = 0; i < batch_size; ++i) {
+            batch->push_back(std::move(requests_.front()));
+            requests_.pop_front();
+        }
+        ++batches_in_flight_;
+        statistics_.request_count += batch_size;
+        ++statistics_.batch_count;
+        statistics_.max_batch_size = std::max(statistics_.max_batch_size, batch_size);
+
+        lock.unlock();
+        executor_.Submit([this, batch] {
+            ProcessBatch(*batch);
+            // Уведомляем под мьютексом: после его освобождения деструктор может удалить очередь
+            std::lock_guard guard(mutex_);
+            --batches_in_flight_;
+            condition_.notify_all();
+        });
+        lock.lock();
+    }
+}
+
+void AsyncSearchQueue::ProcessBatch(std::vector<Request>& batch) {
+    executor_.ParallelFor(batch.size(), [this, &batch](size_t index) {
+        Request& request = batch[index];
+        try {
+            request.result.set_value(search_server_.FindTopDocuments(request.raw_query, request.status));
+        }
+        catch (...) {
+            request.result.set_exception(std::current_exception());
+        }
+    });
+}
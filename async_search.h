@@ -0,0 +1,79 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Число запросов, переданных пулу, и пакетов, на которые их разбила очередь
+struct AsyncSearchStatistics {
+    uint64_t request_count = 0;
+    uint64_t batch_count = 0;
+    // размер самого большого пакета, не больше max_batch_size
+    size_t max_batch_size = 0;
+};
+
+/**
+ * Асинхронная очередь поисковых запросов.
+ *
+ * FindTopDocuments не блокирует вызывающий поток и возвращает std::future.
+ * Запросы, пришедшие одновременно, объединяются в пакеты размером до max_batch_size.
+ * Пакет целиком выполняется на переданном пуле, там же заполняются результаты.
+ * Пока все потоки пула заняты, новые запросы копятся в очереди и попадают в следующий пакет.
+ *
+ * Пример использования:
+ *
+ *  ThreadPool pool(8);
+ *  AsyncSearchQueue queue(search_server, pool);
+ *  auto future = queue.FindTopDocuments("curly cat"s);
+ *  ...
+ *  for (const Document& document : future.get()) { ... }
+ */
+class AsyncSearchQueue {
+public:
+    AsyncSearchQueue(const SearchServer& search_server, ThreadPool& executor, size_t max_batch_size = 64);
+
+    AsyncSearchQueue(const AsyncSearchQueue&) = delete;
+    AsyncSearchQueue& operator=(const AsyncSearchQueue&) = delete;
+
+    // Дожидается выполнения всех принятых запросов
+    ~AsyncSearchQueue();
+
+    std::future<std::vector<Document>> FindTopDocuments(std::string raw_query, DocumentStatus status);
+    std::future<std::vector<Document>> FindTopDocuments(std::string raw_query);
+
+    AsyncSearchStatistics GetStatistics() const;
+
+private:
+    struct Request {
+        std::string raw_query;
+        DocumentStatus status;
+        std::promise<std::vector<Document>> result;
+    };
+
+    const SearchServer& search_server_;
+    ThreadPool& executor_;
+    const size_t max_batch_size_;
+    const size_t max_batches_in_flight_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Request> requests_;
+    size_t batches_in_flight_ = 0;
+    AsyncSearchStatistics statistics_;
+    bool stop_ = false;
+
+    std::thread dispatcher_;
+
+    void DispatchLoop();
+
+    void ProcessBatch(std::vector<Request>& batch);
+};
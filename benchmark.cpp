@@ -0,0 +1,812 @@
+#include "benchmark.h"
+#include "async_search.h"
+#include "concurrent_document_writer.h"
+#include "corpus_loader.h"
+#include "paginator.h"
+#include "process_queries.h"
+#include "profiler.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "scoring.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+#include "snapshot_search_server.h"
+#include "string_processing.h"
+#include "thread_pool.h"
+#include "write_ahead_log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <string_view>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Результаты замеряемых операций складываются сюда, чтобы компилятор не выбросил вычисления
+volatile size_t benchmark_sink = 0;
+
+void Consume(size_t value) {
+    benchmark_sink = benchmark_sink + value;
+}
+
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions& options)
+        : options_(options) {
+    }
+
+    bool IsSelected(const std::string& name) const {
+        return name.find(options_.filter) != std::string::npos;
+    }
+
+    // setup готовит данные одного повтора и не замеряется, function выполняет замеряемые операции.
+    // Возвращает результат замера или nullptr, если замер не выбран
+    template <typename Setup, typename Function>
+    BenchmarkResult* Measure(const std::string& name, size_t operation_count, Setup setup, Function function) {
+        if (!IsSelected(name)) {
+            return nullptr;
+        }
+        BenchmarkResult result;
+        result.name = name;
+        result.operation_count = operation_count;
+        for (size_t i = 0; i < std::max<size_t>(1, options_.repetitions); ++i) {
+            auto state = setup();
+            const Clock::time_point start_time = Clock::now();
+            function(state);
+            result.repetition_times.push_back(Clock::now() - start_time);
+        }
+        results_.push_back(std::move(result));
+        return &results_.back();
+    }
+
+    template <typename Function>
+    BenchmarkResult* Measure(const std::string& name, size_t operation_count, Function function) {
+        return Measure(name, operation_count, [] { return 0; }, [&function](int) { function(); });
+    }
+
+    std::vector<BenchmarkResult> ExtractResults() {
+        return std::move(results_);
+    }
+
+private:
+    const BenchmarkOptions& options_;
+    std::vector<BenchmarkResult> results_;
+};
+
+std::vector<PreparedDocument> PrepareDocuments(const SearchServer& search_server, const SyntheticCorpus& corpus) {
+    std::vector<PreparedDocument> documents;
+    documents.reserve(corpus.documents.size());
+    for (const SyntheticDocument& document : corpus.documents) {
+        documents.push_back(search_server.PrepareDocument(document.id, document.text, document.status, document.ratings));
+    }
+    return documents;
+}
+
+SearchServer MakeSearchServer(const SyntheticCorpus& corpus, ScoringModel scoring_model = ScoringModel::TF_IDF) {
+    SearchServer search_server(corpus.stop_words, scoring_model);
+    search_server.AddDocuments(std::execution::par, PrepareDocuments(search_server, corpus));
+    return search_server;
+}
+
+// Каждый step-й документ корпуса, не больше max_count документов
+std::vector<int> SelectDocumentIds(const SyntheticCorpus& corpus, size_t max_count) {
+    std::vector<int> document_ids;
+    const size_t step = std::max<size_t>(1, corpus.documents.size() / std::max<size_t>(1, max_count));
+    for (size_t i = 0; i < corpus.documents.size() && document_ids.size() < max_count; i += step) {
+        document_ids.push_back(corpus.documents[i].id);
+    }
+    return document_ids;
+}
+
+void AddIndexingBenchmarks(BenchmarkRunner& runner, const SyntheticCorpus& corpus, size_t thread_count) {
+    const auto make_empty_server = [&corpus] {
+        return SearchServer(corpus.stop_words);
+    };
+
+    runner.Measure("AddDocument", corpus.documents.size(), make_empty_server, [&corpus](SearchServer& search_server) {
+        for (const SyntheticDocument& document : corpus.documents) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    });
+    runner.Measure("AddDocuments/seq", corpus.documents.size(), make_empty_server, [&corpus](SearchServer& search_server) {
+        search_server.AddDocuments(std::execution::seq, PrepareDocuments(search_server, corpus));
+    });
+    runner.Measure("AddDocuments/par", corpus.documents.size(), make_empty_server, [&corpus](SearchServer& search_server) {
+        search_server.AddDocuments(std::execution::par, PrepareDocuments(search_server, corpus));
+    });
+
+    // Масштабирование по числу писателей: 1, 2, 4, 8 и thread_count (по умолчанию число ядер)
+    std::vector<size_t> producer_counts = { 1, 2, 4, 8 };
+    if (std::find(producer_counts.begin(), producer_counts.end(), thread_count) == producer_counts.end()) {
+        producer_counts.push_back(thread_count);
+    }
+    for (const size_t producer_count : producer_counts) {
+        runner.Measure("ConcurrentDocumentWriter/" + std::to_string(producer_count), corpus.documents.size(),
+            make_empty_server, [&corpus, producer_count](SearchServer& search_server) {
+                ConcurrentDocumentWriter writer(search_server);
+                std::vector<std::thread> writers;
+                for (size_t i = 0; i < producer_count; ++i) {
+                    writers.emplace_back([&corpus, &writer, i, producer_count] {
+                        for (size_t j = i; j < corpus.documents.size(); j += producer_count) {
+                            const SyntheticDocument& document = corpus.documents[j];
+                            writer.AddDocument(document.id, document.text, document.status, document.ratings);
+                        }
+                    });
+                }
+                for (std::thread& thread : writers) {
+                    thread.join();
+                }
+                writer.Flush();
+            });
+    }
+}
+
+void AddLoadingBenchmarks(BenchmarkRunner& runner, const SyntheticCorpus& corpus) {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string lines_path = (directory / "search_server_benchmark_lines.txt").string();
+    const std::string records_path = (directory / "search_server_benchmark_records.bin").string();
+    {
+        std::ofstream lines(lines_path, std::ios::binary);
+        std::ofstream records(records_path, std::ios::binary);
+        for (const SyntheticDocument& document : corpus.documents) {
+            lines << document.text << '\n';
+            WriteCorpusRecord(records, document.id, document.text, document.status, document.ratings);
+        }
+    }
+
+    const auto make_empty_server = [&corpus] {
+        return SearchServer(corpus.stop_words);
+    };
+    const auto add_benchmark = [&](const std::string& name, const std::string& path, CorpusFormat format) {
+        BenchmarkResult* const result = runner.Measure(name, corpus.documents.size(), make_empty_server,
+            [&path, format](SearchServer& search_server) {
+                Consume(LoadCorpus(search_server, path, format).document_count);
+            });
+        if (result != nullptr) {
+            result->byte_count = std::filesystem::file_size(path);
+        }
+    };
+    add_benchmark("LoadCorpus/lines", lines_path, CorpusFormat::LINES);
+    add_benchmark("LoadCorpus/records", records_path, CorpusFormat::RECORDS);
+
+    std::filesystem::remove(lines_path);
+    std::filesystem::remove(records_path);
+}
+
+// Заменяет плюс-слова запросов префиксами без последней буквы: word → wor*
+std::vector<std::string> MakePrefixQueries(const std::vector<std::string>& queries) {
+    std::vector<std::string> prefix_queries;
+    prefix_queries.reserve(queries.size());
+    for (const std::string& query : queries) {
+        std::string prefix_query;
+        for (const std::string_view word : SplitIntoWordsView(query)) {
+            if (!prefix_query.empty()) {
+                prefix_query += ' ';
+            }
+            if (word.empty() || word[0] == '-') {
+                prefix_query += word;
+            }
+            else {
+                prefix_query += word.substr(0, std::max<size_t>(1, word.size() - 1));
+                prefix_query += '*';
+            }
+        }
+        prefix_queries.push_back(std::move(prefix_query));
+    }
+    return prefix_queries;
+}
+
+// Вносит в каждое плюс-слово запросов опечатку: заменяет средний символ следующим по алфавиту
+std::vector<std::string> MakeTypoQueries(const std::vector<std::string>& queries) {
+    std::vector<std::string> typo_queries;
+    typo_queries.reserve(queries.size());
+    for (const std::string& query : queries) {
+        std::string typo_query;
+        for (const std::string_view word : SplitIntoWordsView(query)) {
+            if (!typo_query.empty()) {
+                typo_query += ' ';
+            }
+            const size_t first_letter = typo_query.size();
+            typo_query += word;
+            if (!word.empty() && word[0] != '-') {
+                char& letter = typo_query[first_letter + word.size() / 2];
+                letter = letter == 'z' ? 'a' : static_cast<char>(letter + 1);
+            }
+        }
+        typo_queries.push_back(std::move(typo_query));
+    }
+    return typo_queries;
+}
+
+void AddSearchBenchmarks(BenchmarkRunner& runner, const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool) {
+    const auto find_all = [&search_server, &queries](auto&& policy) {
+        for (const std::string& query : queries) {
+            Consume(search_server.FindTopDocuments(policy, query).size());
+        }
+    };
+    runner.Measure("FindTopDocuments/seq", queries.size(), [&] { find_all(std::execution::seq); });
+    runner.Measure("FindTopDocuments/par", queries.size(), [&] { find_all(std::execution::par); });
+    runner.Measure("FindTopDocuments/pool", queries.size(), [&] { find_all(pool); });
+    runner.Measure("FindTopDocuments/predicate", queries.size(), [&search_server, &queries] {
+        for (const std::string& query : queries) {
+            Consume(search_server.FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) {
+                return document_id % 2 == 0 && rating >= 0;
+            }).size());
+        }
+    });
+    // буфер и выходной массив общие для всех повторов, как у долгоживущего обработчика запросов
+    SearchResultBuffer buffer;
+    std::vector<PackedDocument> packed_documents(MAX_RESULT_DOCUMENT_COUNT);
+    runner.Measure("FindTopDocuments/buffer", queries.size(), [&search_server, &queries, &buffer, &packed_documents] {
+        for (const std::string& query : queries) {
+            Consume(search_server.FindTopDocuments(query, buffer, packed_documents.data(), packed_documents.size()));
+        }
+    });
+
+    if (runner.IsSelected("FindTopDocuments/impact")) {
+        SearchServer impact_server = search_server;
+        impact_server.SetRankingMode(RankingMode::IMPACT_ORDERED);
+        runner.Measure("FindTopDocuments/impact", queries.size(), [&impact_server, &queries, &buffer, &packed_documents] {
+            for (const std::string& query : queries) {
+                Consume(impact_server.FindTopDocuments(query, buffer, packed_documents.data(), packed_documents.size()));
+            }
+        });
+    }
+    if (runner.IsSelected("FindTopDocuments/soft_stop")) {
+        SearchServer skipping_server = search_server;
+        skipping_server.SetSoftStopWordRatio(0.5);
+        runner.Measure("FindTopDocuments/soft_stop", queries.size(), [&skipping_server, &queries] {
+            for (const std::string& query : queries) {
+                Consume(skipping_server.FindTopDocuments(query).size());
+            }
+        });
+    }
+    if (runner.IsSelected("FindTopDocuments/prefix")) {
+        const std::vector<std::string> prefix_queries = MakePrefixQueries(queries);
+        runner.Measure("FindTopDocuments/prefix", prefix_queries.size(), [&search_server, &prefix_queries] {
+            for (const std::string& query : prefix_queries) {
+                Consume(search_server.FindTopDocuments(query).size());
+            }
+        });
+    }
+    if (runner.IsSelected("FindTopDocuments/fuzzy")) {
+        SearchServer fuzzy_server = search_server;
+        fuzzy_server.SetFuzzySearch(FuzzySearchOptions{});
+        const std::vector<std::string> typo_queries = MakeTypoQueries(queries);
+        runner.Measure("FindTopDocuments/fuzzy", typo_queries.size(), [&fuzzy_server, &typo_queries] {
+            for (const std::string& query : typo_queries) {
+                Consume(fuzzy_server.FindTopDocuments(query).size());
+            }
+        });
+    }
+    // Построение индекса удалений по всему словарю
+    runner.Measure("SetFuzzySearch", 1, [&search_server] {
+        return search_server;
+    }, [](SearchServer& fuzzy_server) {
+        fuzzy_server.SetFuzzySearch(FuzzySearchOptions{});
+    });
+    // Заморозка: вклады всех записей индекса и их сортировка
+    runner.Measure("SetRankingMode/impact", 1, [&search_server] {
+        return search_server;
+    }, [](SearchServer& impact_server) {
+        impact_server.SetRankingMode(RankingMode::IMPACT_ORDERED);
+    });
+
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    const auto match_all = [&search_server, &queries, &document_ids](auto&& policy) {
+        for (size_t i = 0; i < queries.size() && !document_ids.empty(); ++i) {
+            const auto [words, status] = search_server.MatchDocument(policy, queries[i], document_ids[i * 7919 % document_ids.size()]);
+            Consume(words.size());
+        }
+    };
+    runner.Measure("MatchDocument/seq", queries.size(), [&] { match_all(std::execution::seq); });
+    runner.Measure("MatchDocument/par", queries.size(), [&] { match_all(std::execution::par); });
+    runner.Measure("MatchDocument/pool", queries.size(), [&] { match_all(pool); });
+
+    runner.Measure("ProcessQueries/par", queries.size(), [&search_server, &queries] {
+        Consume(ProcessQueries(search_server, queries).size());
+    });
+    runner.Measure("ProcessQueries/pool", queries.size(), [&search_server, &queries, &pool] {
+        Consume(ProcessQueries(pool, search_server, queries).size());
+    });
+    PackedQueryResults packed_results;
+    runner.Measure("ProcessQueries/packed", queries.size(), [&search_server, &queries, &packed_results] {
+        ProcessQueries(search_server, queries, packed_results);
+        Consume(packed_results.documents.size());
+    });
+    runner.Measure("ProcessQueriesJoined", queries.size(), [&search_server, &queries] {
+        Consume(ProcessQueriesJoined(search_server, queries).size());
+    });
+
+    runner.Measure("AsyncSearchQueue", queries.size(), [&search_server, &queries, &pool] {
+        AsyncSearchQueue queue(search_server, pool);
+        std::vector<std::future<std::vector<Document>>> results;
+        results.reserve(queries.size());
+        for (const std::string& query : queries) {
+            results.push_back(queue.FindTopDocuments(query));
+        }
+        for (auto& result : results) {
+            Consume(result.get().size());
+        }
+    });
+    // Замкнутый цикл: каждый из client_count клиентов отправляет следующий запрос, только дождавшись
+    // ответа на предыдущий. Задержка каждого запроса считается от отправки до получения результата
+    std::vector<size_t> client_counts = { 1, pool.GetThreadCount(), 4 * pool.GetThreadCount() };
+    client_counts.erase(std::unique(client_counts.begin(), client_counts.end()), client_counts.end());
+    for (const size_t client_count : client_counts) {
+        std::vector<std::chrono::nanoseconds> latencies;
+        BenchmarkResult* result = runner.Measure("AsyncSearchQueue/closed_loop/" + std::to_string(client_count), queries.size(),
+            [&search_server, &queries, &pool, &latencies, client_count] {
+                AsyncSearchQueue queue(search_server, pool);
+                std::vector<std::vector<std::chrono::nanoseconds>> client_latencies(client_count);
+                std::vector<std::thread> clients;
+                for (size_t i = 0; i < client_count; ++i) {
+                    clients.emplace_back([&queries, &queue, &client_latencies, i, client_count] {
+                        for (size_t j = i; j < queries.size(); j += client_count) {
+                            const Clock::time_point send_time = Clock::now();
+                            Consume(queue.FindTopDocuments(queries[j]).get().size());
+                            client_latencies[i].push_back(Clock::now() - send_time);
+                        }
+                    });
+                }
+                for (std::thread& client : clients) {
+                    client.join();
+                }
+                for (const auto& times : client_latencies) {
+                    latencies.insert(latencies.end(), times.begin(), times.end());
+                }
+            });
+        if (result) {
+            result->request_latencies = std::move(latencies);
+        }
+    }
+    runner.Measure("RequestQueue", queries.size(), [&search_server, &queries] {
+        RequestQueue request_queue(search_server);
+        for (const std::string& query : queries) {
+            Consume(request_queue.AddFindRequest(query).size());
+        }
+    });
+
+    // Страниц в одном наборе результатов мало, поэтому разбиение повторяется
+    const size_t paginate_rounds = 100;
+    const std::vector<Document> documents = ProcessQueriesJoined(search_server, queries);
+    const size_t page_size = 2;
+    runner.Measure("Paginate", paginate_rounds * ((documents.size() + page_size - 1) / page_size), [&documents, paginate_rounds, page_size] {
+        for (size_t i = 0; i < paginate_rounds; ++i) {
+            for (const auto& page : Paginate(documents, page_size)) {
+                Consume(page.begin()->id);
+            }
+        }
+    });
+
+    // Страница по курсору стоит одинаково при любом номере: сравниваются первая и пятидесятая страницы
+    const size_t cursor_page_size = 10;
+    const size_t deep_page_number = 50;
+    if (runner.IsSelected("FindTopDocuments/cursor")) {
+        std::vector<std::pair<std::string_view, SearchCursor>> deep_cursors;
+        for (const std::string& query : queries) {
+            std::optional<SearchCursor> cursor;
+            for (size_t page = 1; page < deep_page_number && (page == 1 || cursor); ++page) {
+                cursor = search_server.FindTopDocuments(query, cursor_page_size, cursor).next_cursor;
+            }
+            if (cursor) {
+                deep_cursors.emplace_back(query, *cursor);
+            }
+        }
+        runner.Measure("FindTopDocuments/cursor/page1", deep_cursors.size(), [&search_server, &deep_cursors, cursor_page_size] {
+            for (const auto& [query, _] : deep_cursors) {
+                Consume(search_server.FindTopDocuments(query, cursor_page_size, std::nullopt).documents.size());
+            }
+        });
+        runner.Measure("FindTopDocuments/cursor/page" + std::to_string(deep_page_number), deep_cursors.size(),
+            [&search_server, &deep_cursors, cursor_page_size] {
+                for (const auto& [query, cursor] : deep_cursors) {
+                    Consume(search_server.FindTopDocuments(query, cursor_page_size, cursor).documents.size());
+                }
+            });
+    }
+}
+
+void AddRemovalBenchmarks(BenchmarkRunner& runner, const SyntheticCorpus& corpus, ThreadPool& pool) {
+    const std::vector<int> removed_ids = SelectDocumentIds(corpus, 1000);
+    const auto make_server = [&corpus] {
+        return MakeSearchServer(corpus);
+    };
+    const auto remove_all = [&removed_ids](SearchServer& search_server, auto&& policy) {
+        for (const int document_id : removed_ids) {
+            search_server.RemoveDocument(policy, document_id);
+        }
+    };
+    runner.Measure("RemoveDocument/seq", removed_ids.size(), make_server, [&](SearchServer& search_server) {
+        remove_all(search_server, std::execution::seq);
+    });
+    runner.Measure("RemoveDocument/par", removed_ids.size(), make_server, [&](SearchServer& search_server) {
+        remove_all(search_server, std::execution::par);
+    });
+    runner.Measure("RemoveDocument/pool", removed_ids.size(), make_server, [&](SearchServer& search_server) {
+        for (const int document_id : removed_ids) {
+            search_server.RemoveDocument(pool, document_id);
+        }
+    });
+    runner.Measure("RemoveDocuments/seq", removed_ids.size(), make_server, [&removed_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(std::execution::seq, removed_ids);
+    });
+    runner.Measure("RemoveDocuments/par", removed_ids.size(), make_server, [&removed_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(std::execution::par, removed_ids);
+    });
+
+    // RemoveDuplicates сообщает о каждом дубликате в std::cout, на время замера вывод отключается
+    const auto remove_duplicates = [](SearchServer& search_server, double min_similarity) {
+        std::streambuf* const output = std::cout.rdbuf(nullptr);
+        RemoveDuplicates(search_server, min_similarity);
+        std::cout.rdbuf(output);
+        std::cout.clear();
+    };
+    runner.Measure("RemoveDuplicates/exact", corpus.documents.size(), make_server, [&](SearchServer& search_server) {
+        remove_duplicates(search_server, 1.0);
+    });
+    runner.Measure("RemoveDuplicates/minhash", corpus.documents.size(), make_server, [&](SearchServer& search_server) {
+        remove_duplicates(search_server, 0.8);
+    });
+}
+
+void AddServerVariantBenchmarks(BenchmarkRunner& runner, const SyntheticCorpus& corpus,
+    const SearchServer& search_server, const std::vector<std::string>& queries) {
+    for (const size_t shard_count : { 1, 2, 4, 8, 16 }) {
+        const std::string name = "ShardedSearchServer/FindTopDocuments/" + std::to_string(shard_count);
+        if (!runner.IsSelected(name)) {
+            continue;
+        }
+        ShardedSearchServer sharded_server(corpus.stop_words, shard_count);
+        for (const SyntheticDocument& document : corpus.documents) {
+            sharded_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        runner.Measure(name, queries.size(), [&sharded_server, &queries] {
+            for (const std::string& query : queries) {
+                Consume(sharded_server.FindTopDocuments(std::execution::par, query).size());
+            }
+        });
+    }
+
+    if (runner.IsSelected("SnapshotSearchServer/FindTopDocuments")) {
+        const SnapshotSearchServer snapshot_server(search_server);
+        runner.Measure("SnapshotSearchServer/FindTopDocuments", queries.size(), [&snapshot_server, &queries] {
+            for (const std::string& query : queries) {
+                Consume(snapshot_server.FindTopDocuments(query).size());
+            }
+        });
+    }
+    // Публикация копирует указатели на блоки словаря и таблиц и изменённые блоки и списки документов,
+    // поэтому её время почти не зависит от размера корпуса. В режиме IMPACT_ORDERED публикация
+    // пересчитывает вклады всех документов: они зависят от IDF и средней длины документа
+    for (const size_t fraction : { 8, 4, 2, 1 }) {
+        const size_t document_count = corpus.documents.size() / fraction;
+        for (const RankingMode ranking_mode : { RankingMode::EXHAUSTIVE, RankingMode::IMPACT_ORDERED }) {
+            const bool is_impact = ranking_mode == RankingMode::IMPACT_ORDERED;
+            const std::string name = "SnapshotSearchServer/Publish/" + std::string(is_impact ? "impact/" : "") + std::to_string(document_count);
+            if (!runner.IsSelected(name)) {
+                continue;
+            }
+            SearchServer initial_version(corpus.stop_words);
+            for (size_t i = 0; i < document_count; ++i) {
+                const SyntheticDocument& document = corpus.documents[i];
+                initial_version.AddDocument(document.id, document.text, document.status, document.ratings);
+            }
+            initial_version.SetRankingMode(ranking_mode);
+
+            const size_t publish_count = std::min<size_t>(is_impact ? 20 : 100, corpus.documents.size());
+            runner.Measure(name, publish_count, [&initial_version] {
+                return std::make_unique<SnapshotSearchServer>(initial_version);
+            }, [&corpus, publish_count](std::unique_ptr<SnapshotSearchServer>& snapshot_server) {
+                const int first_id = static_cast<int>(corpus.documents.size());
+                for (size_t i = 0; i < publish_count; ++i) {
+                    const SyntheticDocument& document = corpus.documents[i];
+                    snapshot_server->AddDocument(first_id + static_cast<int>(i), document.text, document.status, document.ratings);
+                    snapshot_server->Publish();
+                }
+            });
+        }
+    }
+}
+
+void AddScoringBenchmarks(BenchmarkRunner& runner, const SyntheticCorpus& corpus, const std::vector<std::string>& queries) {
+    if (runner.IsSelected("FindTopDocuments/bm25")) {
+        const SearchServer bm25_server = MakeSearchServer(corpus, ScoringModel::BM25);
+        runner.Measure("FindTopDocuments/bm25", queries.size(), [&bm25_server, &queries] {
+            for (const std::string& query : queries) {
+                Consume(bm25_server.FindTopDocuments(query).size());
+            }
+        });
+    }
+
+    // Внутренний цикл подсчёта релевантности: записи одного слова в плоских массивах
+    // и те же записи в списке документов слова. Разница показывает выигрыш векторизации и непрерывной памяти
+    const size_t posting_count = size_t{ 1 } << 20;
+    const double inverse_document_freq = 1.5;
+    std::vector<uint32_t> counts(posting_count);
+    std::vector<uint32_t> word_counts(posting_count);
+    uint64_t total_word_count = 0;
+    for (size_t i = 0; i < posting_count; ++i) {
+        counts[i] = 1 + i % 3;
+        word_counts[i] = 20 + i * 7919 % 80;
+        total_word_count += word_counts[i];
+    }
+    const ScoringCorpus scoring_corpus{ static_cast<double>(posting_count), static_cast<double>(total_word_count) / posting_count };
+
+    const auto add_kernel_benchmarks = [&](const std::string& model_name, const auto& scoring) {
+        using Scoring = std::decay_t<decltype(scoring)>;
+        const std::string flat_name = "ScoringKernel/" + model_name + "/flat";
+        const std::string map_name = "ScoringKernel/" + model_name + "/map";
+        if (!runner.IsSelected(flat_name) && !runner.IsSelected(map_name)) {
+            return;
+        }
+        std::vector<double> norms(posting_count);
+        std::map<int, uint32_t> postings;
+        for (size_t i = 0; i < posting_count; ++i) {
+            norms[i] = Scoring::ComputeDocumentNorm(word_counts[i]);
+            postings.emplace_hint(postings.end(), static_cast<int>(i), counts[i]);
+        }
+        std::vector<double> scores(posting_count, 0.0);
+
+        BenchmarkResult* const result = runner.Measure(flat_name, posting_count, [&] {
+            AccumulateTermScores(scoring, inverse_document_freq, counts.data(), norms.data(), posting_count, scores.data());
+            Consume(static_cast<size_t>(scores.back()));
+        });
+        if (result != nullptr) {
+            // чтение числа вхождений, нормировки и суммы, запись суммы
+            result->byte_count = posting_count * (sizeof(uint32_t) + 3 * sizeof(double));
+        }
+        runner.Measure(map_name, posting_count, [&] {
+            for (const auto [document_id, count] : postings) {
+                scores[document_id] += scoring.ComputeTermWeight(count, norms[document_id]) * inverse_document_freq;
+            }
+            Consume(static_cast<size_t>(scores.back()));
+        });
+    };
+    add_kernel_benchmarks("tf_idf", TfIdfScoring(scoring_corpus));
+    add_kernel_benchmarks("bm25", Bm25Scoring(scoring_corpus));
+}
+
+void AddWriteAheadLogBenchmarks(BenchmarkRunner& runner, const SyntheticCorpus& corpus) {
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_benchmark.wal").string();
+
+    struct LoggedServer {
+        SearchServer search_server;
+        std::unique_ptr<WriteAheadLog> log;
+    };
+    const auto add_benchmark = [&](const std::string& name, LogDurability durability, size_t document_count) {
+        runner.Measure(name, document_count, [&corpus, &path, durability] {
+            std::filesystem::remove(path);
+            auto logged_server = std::make_unique<LoggedServer>(LoggedServer{ SearchServer(corpus.stop_words), nullptr });
+            logged_server->log = std::make_unique<WriteAheadLog>(logged_server->search_server, path, durability);
+            return logged_server;
+        }, [&corpus, document_count](std::unique_ptr<LoggedServer>& logged_server) {
+            for (size_t i = 0; i < document_count; ++i) {
+                const SyntheticDocument& document = corpus.documents[i];
+                logged_server->log->AddDocument(document.id, document.text, document.status, document.ratings);
+            }
+            logged_server->log->Sync();
+        });
+    };
+    add_benchmark("WriteAheadLog/AddDocument/none", LogDurability::NONE, corpus.documents.size());
+    add_benchmark("WriteAheadLog/AddDocument/group", LogDurability::GROUP, corpus.documents.size());
+    // Синхронизация каждой записи на порядки медленнее, поэтому записей меньше
+    add_benchmark("WriteAheadLog/AddDocument/every_record", LogDurability::EVERY_RECORD, std::min<size_t>(200, corpus.documents.size()));
+
+    if (runner.IsSelected("WriteAheadLog/Replay")) {
+        std::filesystem::remove(path);
+        {
+            SearchServer search_server(corpus.stop_words);
+            WriteAheadLog log(search_server, path, LogDurability::NONE);
+            for (const SyntheticDocument& document : corpus.documents) {
+                log.AddDocument(document.id, document.text, document.status, document.ratings);
+            }
+        }
+        runner.Measure("WriteAheadLog/Replay", corpus.documents.size(), [&corpus, &path] {
+            SearchServer search_server(corpus.stop_words);
+            WriteAheadLog log(search_server, path, LogDurability::NONE);
+            Consume(log.GetReplayedRecordCount());
+        });
+    }
+    std::filesystem::remove(path);
+}
+
+void AddProfilerBenchmarks(BenchmarkRunner& runner) {
+    const size_t sample_count = 1000000;
+    runner.Measure("PROFILE_SCOPE", sample_count, [sample_count] {
+        for (size_t i = 0; i < sample_count; ++i) {
+            PROFILE_SCOPE("benchmark");
+            Consume(i);
+        }
+    });
+}
+
+} // namespace
+
+double BenchmarkResult::GetMedianNanosecondsPerOperation() const {
+    if (repetition_times.empty() || operation_count == 0) {
+        return 0.0;
+    }
+    std::vector<std::chrono::nanoseconds> times = repetition_times;
+    const auto median = times.begin() + (times.size() - 1) / 2;
+    std::nth_element(times.begin(), median, times.end());
+    return static_cast<double>(median->count()) / operation_count;
+}
+
+double BenchmarkResult::GetMinNanosecondsPerOperation() const {
+    if (repetition_times.empty() || operation_count == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(std::min_element(repetition_times.begin(), repetition_times.end())->count()) / operation_count;
+}
+
+double BenchmarkResult::GetGigabytesPerSecond() const {
+    const double nanoseconds_per_operation = GetMedianNanosecondsPerOperation();
+    if (nanoseconds_per_operation == 0.0) {
+        return 0.0;
+    }
+    return byte_count / (nanoseconds_per_operation * operation_count);
+}
+
+std::chrono::nanoseconds BenchmarkResult::GetLatencyPercentile(double percentile) const {
+    if (request_latencies.empty()) {
+        return {};
+    }
+    std::vector<std::chrono::nanoseconds> latencies = request_latencies;
+    const size_t rank = std::min(latencies.size() - 1, static_cast<size_t>(percentile / 100.0 * latencies.size()));
+    std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+    return latencies[rank];
+}
+
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options) {
+    const SyntheticCorpus corpus = GenerateCorpus(options.corpus);
+    const std::vector<std::string> queries = GenerateQueries(corpus, options.corpus, options.queries);
+    const SearchServer search_server = MakeSearchServer(corpus);
+    ThreadPool pool(std::max<size_t>(1, options.thread_count));
+
+    BenchmarkRunner runner(options);
+    AddIndexingBenchmarks(runner, corpus, std::max<size_t>(1, options.thread_count));
+    AddLoadingBenchmarks(runner, corpus);
+    AddSearchBenchmarks(runner, search_server, queries, pool);
+    AddRemovalBenchmarks(runner, corpus, pool);
+    AddServerVariantBenchmarks(runner, corpus, search_server, queries);
+    AddScoringBenchmarks(runner, corpus, queries);
+    AddWriteAheadLogBenchmarks(runner, corpus);
+    AddProfilerBenchmarks(runner);
+    return runner.ExtractResults();
+}
+
+void PrintJson(std::ostream& out, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results) {
+    const CorpusOptions& corpus = options.corpus;
+    out << "{\"corpus\": {\"document_count\": " << corpus.document_count
+        << ", \"min_document_words\": " << corpus.min_document_words
+        << ", \"max_document_words\": " << corpus.max_document_words
+        << ", \"vocabulary_size\": " << corpus.vocabulary_size
+        << ", \"zipf_exponent\": " << corpus.zipf_exponent
+        << ", \"stop_word_count\": " << corpus.stop_word_count
+        << ", \"stop_word_ratio\": " << corpus.stop_word_ratio
+        << ", \"duplicate_ratio\": " << corpus.duplicate_ratio
+        << ", \"seed\": " << corpus.seed << "},\n";
+    const QueryOptions& queries = options.queries;
+    out << " \"queries\": {\"query_count\": " << queries.query_count
+        << ", \"min_plus_words\": " << queries.min_plus_words
+        << ", \"max_plus_words\": " << queries.max_plus_words
+        << ", \"max_minus_words\": " << queries.max_minus_words
+        << ", \"stop_word_probability\": " << queries.stop_word_probability
+        << ", \"seed\": " << queries.seed << "},\n";
+    out << " \"repetitions\": " << options.repetitions
+        << ", \"thread_count\": " << options.thread_count << ",\n";
+    out << " \"benchmarks\": [";
+    bool is_first = true;
+    for (const BenchmarkResult& result : results) {
+        out << (is_first ? "\n" : ",\n");
+        is_first = false;
+        out << "  {\"name\": \"" << result.name << "\""
+            << ", \"operations\": " << result.operation_count
+            << ", \"median_ns_per_operation\": " << result.GetMedianNanosecondsPerOperation()
+            << ", \"min_ns_per_operation\": " << result.GetMinNanosecondsPerOperation()
+            ;
+        if (result.byte_count > 0) {
+            out << ", \"bytes\": " << result.byte_count
+                << ", \"gigabytes_per_second\": " << result.GetGigabytesPerSecond();
+        }
+        if (!result.request_latencies.empty()) {
+            out << ", \"latency_p50_ns\": " << result.GetLatencyPercentile(50.0).count()
+                << ", \"latency_p99_ns\": " << result.GetLatencyPercentile(99.0).count();
+        }
+        out << ", \"repetition_ns\": [";
+        for (size_t i = 0; i < result.repetition_times.size(); ++i) {
+            out << (i > 0 ? ", " : "") << result.repetition_times[i].count();
+        }
+        out << "]}";
+    }
+    out << "\n]}\n";
+}
+
+SoftStopWordReport CompareSoftStopWords(const BenchmarkOptions& options, double ratio) {
+    const SyntheticCorpus corpus = GenerateCorpus(options.corpus);
+    const std::vector<std::string> queries = GenerateQueries(corpus, options.corpus, options.queries);
+    const SearchServer search_server = MakeSearchServer(corpus);
+    SearchServer skipping_server = search_server;
+    skipping_server.SetSoftStopWordRatio(ratio);
+
+    SoftStopWordReport report;
+    report.ratio = ratio;
+    for (const auto& [word, document_share] : skipping_server.GetSoftStopWords()) {
+        report.words.emplace_back(std::string(word), document_share);
+    }
+    report.query_count = queries.size();
+
+    const auto find_all = [&options, &queries](const SearchServer& server, std::chrono::nanoseconds& best_time) {
+        std::vector<std::vector<Document>> results(queries.size());
+        for (size_t repetition = 0; repetition < std::max<size_t>(1, options.repetitions); ++repetition) {
+            const Clock::time_point start_time = Clock::now();
+            for (size_t i = 0; i < queries.size(); ++i) {
+                results[i] = server.FindTopDocuments(queries[i]);
+            }
+            const std::chrono::nanoseconds time = Clock::now() - start_time;
+            best_time = repetition == 0 ? time : std::min(best_time, time);
+        }
+        return results;
+    };
+    const std::vector<std::vector<Document>> full_results = find_all(search_server, report.full_time);
+    const std::vector<std::vector<Document>> skipping_results = find_all(skipping_server, report.skipping_time);
+
+    double overlap_sum = 0.0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        // Статистика запроса показывает, были ли в нём пропущены слова
+        QueryStats query_stats;
+        {
+            QueryStatsCollector collector(query_stats);
+            skipping_server.FindTopDocuments(queries[i]);
+        }
+        report.affected_query_count += query_stats.soft_stop_terms > 0;
+
+        const std::vector<Document>& full = full_results[i];
+        const std::vector<Document>& skipping = skipping_results[i];
+        const bool is_identical = full.size() == skipping.size()
+            && std::equal(full.begin(), full.end(), skipping.begin(),
+                [](const Document& lhs, const Document& rhs) {
+                    return lhs.id == rhs.id;
+            });
+        report.identical_query_count += is_identical;
+
+        size_t common_count = 0;
+        for (const Document& document : full) {
+            const auto it = std::find_if(skipping.begin(), skipping.end(),
+                [&document](const Document& other) {
+                    return other.id == document.id;
+            });
+            if (it != skipping.end()) {
+                ++common_count;
+                report.max_relevance_difference = std::max(report.max_relevance_difference, std::abs(it->relevance - document.relevance));
+            }
+        }
+        overlap_sum += full.empty() ? 1.0 : static_cast<double>(common_count) / full.size();
+    }
+    report.average_overlap = queries.empty() ? 1.0 : overlap_sum / queries.size();
+    return report;
+}
+
+void PrintJson(std::ostream& out, const SoftStopWordReport& report) {
+    out << "{\"ratio\": " << report.ratio
+        << ", \"query_count\": " << report.query_count
+        << ", \"affected_query_count\": " << report.affected_query_count
+        << ", \"identical_query_count\": " << report.identical_query_count
+        << ", \"average_overlap\": " << report.average_overlap
+        << ", \"max_relevance_difference\": " << report.max_relevance_difference
+        << ", \"full_time_ns\": " << report.full_time.count()
+        << ", \"skipping_time_ns\": " << report.skipping_time.count() << ",\n";
+    out << " \"soft_stop_words\": [";
+    for (size_t i = 0; i < report.words.size(); ++i) {
+        out << (i > 0 ? ", " : "") << "{\"word\": \"" << report.words[i].first << "\", \"document_share\": " << report.words[i].second << "}";
+    }
+    out << "]}\n";
+}
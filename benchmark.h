@@ -0,0 +1,83 @@
+#pragma once
+
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchmarkOptions {
+    CorpusOptions corpus;
+    QueryOptions queries;
+    size_t repetitions = 5;
+    // число потоков ThreadPool и писателей в многопоточных замерах
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    // выполняются только замеры, в имени которых есть эта подстрока
+    std::string filter;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    // число операций в одном повторе: документов, запросов, страниц
+    size_t operation_count = 0;
+    // время каждого повтора
+    std::vector<std::chrono::nanoseconds> repetition_times;
+    // объём обработанных за повтор данных, если замер измеряет пропускную способность
+    size_t byte_count = 0;
+    // задержки отдельных запросов всех повторов, если замер измеряет их
+    std::vector<std::chrono::nanoseconds> request_latencies;
+
+    // время операции по медианному повтору
+    double GetMedianNanosecondsPerOperation() const;
+    double GetMinNanosecondsPerOperation() const;
+    // по медианному повтору
+    double GetGigabytesPerSecond() const;
+    // задержка, которую не превышают percentile процентов запросов
+    std::chrono::nanoseconds GetLatencyPercentile(double percentile) const;
+};
+
+/**
+ * Замеряет основные операции поискового сервера на синтетическом корпусе.
+ *
+ * Корпус и запросы генерируются детерминированно, поэтому результаты разных версий
+ * можно сравнивать между собой. Каждый замер повторяется options.repetitions раз
+ * на заново подготовленных данных, подготовка в замер не входит.
+ *
+ * Пример использования:
+ *
+ *  BenchmarkOptions options;
+ *  options.filter = "FindTopDocuments"s;
+ *  PrintJson(std::cout, options, RunBenchmarks(options));
+ */
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options);
+
+// Выводит параметры и результаты замеров одним JSON-объектом
+void PrintJson(std::ostream& out, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results);
+
+// Как пропуск частых слов (SearchServer::SetSoftStopWordRatio) меняет результаты набора запросов
+struct SoftStopWordReport {
+    double ratio = 0.0;
+    // мягкие стоп-слова корпуса и доли содержащих их документов
+    std::vector<std::pair<std::string, double>> words;
+    size_t query_count = 0;
+    // запросы, в которых пропущено хотя бы одно слово
+    size_t affected_query_count = 0;
+    // запросы, лучшие документы которых совпали с полным поиском вместе с порядком
+    size_t identical_query_count = 0;
+    // средняя по запросам доля лучших документов полного поиска, оставшихся среди лучших
+    double average_overlap = 0.0;
+    // наибольшее отличие релевантности документа, найденного обоими поисками
+    double max_relevance_difference = 0.0;
+    // время всех запросов по лучшему повтору
+    std::chrono::nanoseconds full_time{};
+    std::chrono::nanoseconds skipping_time{};
+};
+
+// Выполняет запросы синтетического корпуса с пропуском слов, которые есть больше чем в доле ratio
+// документов, и без него и сравнивает лучшие документы
+SoftStopWordReport CompareSoftStopWords(const BenchmarkOptions& options, double ratio);
+
+void PrintJson(std::ostream& out, const SoftStopWordReport& report);
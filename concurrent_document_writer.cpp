@@ -0,0 +1,46 @@
+#include "concurrent_document_writer.h"
+
+#include <execution>
+#include <mutex>
+
+ConcurrentDocumentWriter::ConcurrentDocumentWriter(SearchServer& search_server, size_t bucket_count)
+    : search_server_(search_server)
+    , pending_documents_(bucket_count) {
+}
+
+void ConcurrentDocumentWriter::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::shared_lock lock(server_mutex_);
+    PreparedDocument prepared = search_server_.PrepareDocument(document_id, document, status, ratings);
+
+    auto access = pending_documents_[document_id];
+    if (access.ref_to_value) {
+        throw std::invalid_argument("документ c id ранее добавленного документа"s);
+    }
+    access.ref_to_value = std::move(prepared);
+}
+
+size_t ConcurrentDocumentWriter::Flush() {
+    std::unique_lock lock(server_mutex_);
+    if (search_server_.IsMemoryBudgetExceeded()) {
+        return 0;
+    }
+
+    // Сервер получает копии документов. Если AddDocuments бросит исключение, документы
+    // возвращаются в корзины и будут добавлены следующим вызовом Flush
+    auto pending = pending_documents_.ExtractOrdinaryMap();
+    std::vector<PreparedDocument> documents;
+    documents.reserve(pending.size());
+    for (const auto& [document_id, document] : pending) {
+        documents.push_back(*document);
+    }
+    try {
+        search_server_.AddDocuments(std::execution::par, std::move(documents));
+    }
+    catch (...) {
+        for (auto& [document_id, document] : pending) {
+            pending_documents_[document_id].ref_to_value = std::move(document);
+        }
+        throw;
+    }
+    return pending.size();
+}
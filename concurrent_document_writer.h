@@ -0,0 +1,51 @@
+#pragma once
+
+#include "concurrent_map.h"
+#include "document.h"
+#include "search_server.h"
+
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+
+/**
+ * Добавление документов в поисковый сервер из нескольких потоков.
+ *
+ * AddDocument можно вызывать одновременно из разных потоков: документ проверяется
+ * и разбирается на слова без блокировок, затем откладывается в одну из корзин
+ * по id документа. Flush добавляет накопленные документы в сервер одним пакетом,
+ * и только тогда они становятся видны поиску.
+ *
+ * Поиск по серверу безопасен между вызовами Flush. Пока существует писатель,
+ * сервер не следует изменять напрямую.
+ *
+ * Пример использования:
+ *
+ *  ConcurrentDocumentWriter writer(search_server);
+ *  // потоки-производители
+ *  writer.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+ *  // поток, владеющий сервером
+ *  writer.Flush();
+ */
+class ConcurrentDocumentWriter {
+public:
+    explicit ConcurrentDocumentWriter(SearchServer& search_server, size_t bucket_count = 64);
+
+    ConcurrentDocumentWriter(const ConcurrentDocumentWriter&) = delete;
+    ConcurrentDocumentWriter& operator=(const ConcurrentDocumentWriter&) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Добавляет в сервер все отложенные документы. Возвращает число добавленных документов.
+    // Если память сервера превышает заданный ему предел, документы остаются отложенными
+    // до следующего вызова и возвращается 0. Если сервер не принял пакет и бросил исключение,
+    // документы тоже остаются отложенными
+    size_t Flush();
+
+private:
+    SearchServer& search_server_;
+    // AddDocument читает сервер, Flush его изменяет
+    std::shared_mutex server_mutex_;
+    ConcurrentMap<int, std::optional<PreparedDocument>> pending_documents_;
+};
@@ -43,7 +43,17 @@ public:
         }
         return result;
     }
-    
+
+    // Как BuildOrdinaryMap, но переносит элементы, оставляя словарь пустым
+    std::map<Key, Value> ExtractOrdinaryMap() {
+        std::map<Key, Value> result;
+        for (auto& [mutex, map] : buckets_) {
+            std::lock_guard guard(mutex);
+            result.merge(map);
+        }
+        return result;
+    }
+
     auto Erase(const Key& key) { 
 		uint64_t tmp_key = static_cast<uint64_t>(key) % buckets_.size(); 
 		std::lock_guard guard(buckets_[tmp_key].mutex); 
@@ -0,0 +1,179 @@
+#include "corpus_generator.h"
+#include "string_processing.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Генератор splitmix64. Распределения стандартной библиотеки не используются:
+// их результаты зависят от реализации, а корпус должен совпадать на всех платформах
+class Random {
+public:
+    explicit Random(uint64_t seed)
+        : state_(seed) {
+    }
+
+    uint64_t Next() {
+        uint64_t value = (state_ += 0x9e3779b97f4a7c15ULL);
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    // Число из [0, 1)
+    double NextDouble() {
+        return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+    }
+
+    // Число из [min_value, max_value]
+    uint64_t NextInRange(uint64_t min_value, uint64_t max_value) {
+        return min_value + Next() % (max_value - min_value + 1);
+    }
+
+private:
+    uint64_t state_;
+};
+
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double exponent)
+        : cumulative_weights_(std::max<size_t>(1, size)) {
+        double total_weight = 0.0;
+        for (size_t rank = 0; rank < cumulative_weights_.size(); ++rank) {
+            total_weight += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+            cumulative_weights_[rank] = total_weight;
+        }
+        for (double& weight : cumulative_weights_) {
+            weight /= total_weight;
+        }
+    }
+
+    size_t operator()(Random& random) const {
+        const auto it = std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), random.NextDouble());
+        return std::min<size_t>(it - cumulative_weights_.begin(), cumulative_weights_.size() - 1);
+    }
+
+private:
+    std::vector<double> cumulative_weights_;
+};
+
+// Слово из строчных латинских букв с номером index. Разные номера дают разные слова,
+// однобуквенные и двухбуквенные слова пропускаются
+std::string MakeWord(size_t index) {
+    index += 26 + 26 * 26;
+    std::string word;
+    do {
+        word.push_back(static_cast<char>('a' + index % 26));
+        index /= 26;
+    } while (index-- > 0);
+    return word;
+}
+
+DocumentStatus MakeStatus(Random& random, const std::array<double, 4>& weights) {
+    double total_weight = 0.0;
+    for (const double weight : weights) {
+        total_weight += weight;
+    }
+    double value = random.NextDouble() * total_weight;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        if (value < weights[i]) {
+            return static_cast<DocumentStatus>(i);
+        }
+        value -= weights[i];
+    }
+    return DocumentStatus::ACTUAL;
+}
+
+} // namespace
+
+SyntheticCorpus GenerateCorpus(const CorpusOptions& options) {
+    SyntheticCorpus corpus;
+    std::vector<std::string> stop_words;
+    for (size_t i = 0; i < options.stop_word_count; ++i) {
+        stop_words.push_back(MakeWord(i));
+    }
+    for (size_t i = 0; i < options.vocabulary_size; ++i) {
+        corpus.vocabulary.push_back(MakeWord(options.stop_word_count + i));
+    }
+    for (const std::string& stop_word : stop_words) {
+        if (!corpus.stop_words.empty()) {
+            corpus.stop_words.push_back(' ');
+        }
+        corpus.stop_words += stop_word;
+    }
+
+    Random random(options.seed);
+    const ZipfDistribution word_distribution(corpus.vocabulary.size(), options.zipf_exponent);
+    const size_t max_document_words = std::max(options.min_document_words, options.max_document_words);
+    const int max_rating = std::max(options.min_rating, options.max_rating);
+
+    corpus.documents.reserve(options.document_count);
+    for (size_t i = 0; i < options.document_count; ++i) {
+        SyntheticDocument document;
+        document.id = static_cast<int>(i);
+        document.status = MakeStatus(random, options.status_weights);
+        const size_t rating_count = random.NextInRange(0, options.max_rating_count);
+        for (size_t j = 0; j < rating_count; ++j) {
+            document.ratings.push_back(options.min_rating + static_cast<int>(random.NextInRange(0, max_rating - options.min_rating)));
+        }
+
+        if (i > 0 && random.NextDouble() < options.duplicate_ratio) {
+            document.text = corpus.documents[random.NextInRange(0, i - 1)].text;
+        }
+        else {
+            const size_t word_count = random.NextInRange(options.min_document_words, max_document_words);
+            for (size_t j = 0; j < word_count; ++j) {
+                if (j > 0) {
+                    document.text.push_back(' ');
+                }
+                if (!stop_words.empty() && random.NextDouble() < options.stop_word_ratio) {
+                    document.text += stop_words[random.NextInRange(0, stop_words.size() - 1)];
+                }
+                else if (!corpus.vocabulary.empty()) {
+                    document.text += corpus.vocabulary[word_distribution(random)];
+                }
+            }
+        }
+        corpus.documents.push_back(std::move(document));
+    }
+    return corpus;
+}
+
+std::vector<std::string> GenerateQueries(const SyntheticCorpus& corpus, const CorpusOptions& corpus_options, const QueryOptions& options) {
+    const std::vector<std::string> stop_words = SplitIntoWords(corpus.stop_words);
+    Random random(options.seed);
+    const ZipfDistribution word_distribution(corpus.vocabulary.size(), corpus_options.zipf_exponent);
+    const size_t max_plus_words = std::max(options.min_plus_words, options.max_plus_words);
+
+    std::vector<std::string> queries;
+    queries.reserve(options.query_count);
+    for (size_t i = 0; i < options.query_count; ++i) {
+        std::string query;
+        const auto add_word = [&query](const std::string& word, bool is_minus) {
+            if (!query.empty()) {
+                query.push_back(' ');
+            }
+            if (is_minus) {
+                query.push_back('-');
+            }
+            query += word;
+        };
+
+        const size_t plus_word_count = random.NextInRange(options.min_plus_words, max_plus_words);
+        for (size_t j = 0; j < plus_word_count; ++j) {
+            if (!stop_words.empty() && random.NextDouble() < options.stop_word_probability) {
+                add_word(stop_words[random.NextInRange(0, stop_words.size() - 1)], false);
+            }
+            else if (!corpus.vocabulary.empty()) {
+                add_word(corpus.vocabulary[word_distribution(random)], false);
+            }
+        }
+        const size_t minus_word_count = random.NextInRange(0, options.max_minus_words);
+        for (size_t j = 0; j < minus_word_count && !corpus.vocabulary.empty(); ++j) {
+            add_word(corpus.vocabulary[word_distribution(random)], true);
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "document.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Параметры синтетического корпуса. Частоты слов подчиняются закону Ципфа:
+// вероятность k-го по частоте слова пропорциональна 1 / k^zipf_exponent
+struct CorpusOptions {
+    size_t document_count = 10000;
+    size_t min_document_words = 10;
+    size_t max_document_words = 50;
+    size_t vocabulary_size = 20000;
+    double zipf_exponent = 1.0;
+    size_t stop_word_count = 20;
+    // доля стоп-слов среди слов документов
+    double stop_word_ratio = 0.2;
+    // доля документов, повторяющих набор слов одного из предыдущих документов
+    double duplicate_ratio = 0.05;
+    // относительные частоты статусов ACTUAL, IRRELEVANT, BANNED, REMOVED
+    std::array<double, 4> status_weights = { 0.85, 0.05, 0.05, 0.05 };
+    size_t max_rating_count = 5;
+    int min_rating = -10;
+    int max_rating = 10;
+    uint64_t seed = 42;
+};
+
+// Параметры запросов к синтетическому корпусу. Слова запросов выбираются по тому же закону Ципфа
+struct QueryOptions {
+    size_t query_count = 1000;
+    size_t min_plus_words = 1;
+    size_t max_plus_words = 4;
+    size_t max_minus_words = 1;
+    // вероятность, что плюс-слово окажется стоп-словом
+    double stop_word_probability = 0.1;
+    uint64_t seed = 43;
+};
+
+struct SyntheticDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+struct SyntheticCorpus {
+    // стоп-слова через пробел, для конструктора SearchServer
+    std::string stop_words;
+    // слова в порядке убывания частоты
+    std::vector<std::string> vocabulary;
+    std::vector<SyntheticDocument> documents;
+};
+
+// Генераторы детерминированы: при одинаковых параметрах результат одинаков на любой платформе
+SyntheticCorpus GenerateCorpus(const CorpusOptions& options);
+
+std::vector<std::string> GenerateQueries(const SyntheticCorpus& corpus, const CorpusOptions& corpus_options, const QueryOptions& options);
@@ -0,0 +1,252 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Меньшие части не окупают запуск параллельной обработки
+constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        const int file_descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file_descriptor < 0) {
+            ThrowSystemError("не удалось открыть корпус");
+        }
+        struct stat file_status {};
+        if (fstat(file_descriptor, &file_status) != 0) {
+            const int error = errno;
+            close(file_descriptor);
+            throw std::system_error(error, std::generic_category(), "не удалось узнать размер корпуса");
+        }
+        size_ = static_cast<size_t>(file_status.st_size);
+        if (size_ > 0) {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+            if (data_ == MAP_FAILED) {
+                const int error = errno;
+                close(file_descriptor);
+                throw std::system_error(error, std::generic_category(), "не удалось отобразить корпус в память");
+            }
+            // Части файла читаются параллельно, поэтому страницы подгружаются заранее
+            madvise(data_, size_, MADV_WILLNEED);
+        }
+        close(file_descriptor);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (size_ > 0) {
+            munmap(data_, size_);
+        }
+    }
+
+    std::string_view GetData() const noexcept {
+        return { static_cast<const char*>(data_), size_ };
+    }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+struct CorpusRecord {
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+size_t GetChunkCount(size_t size) {
+    const size_t max_chunk_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    return std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1, max_chunk_count);
+}
+
+// Строки каждой части файла. Части начинаются после перевода строки
+std::vector<std::vector<std::string_view>> SplitIntoLines(std::string_view data) {
+    const size_t chunk_count = GetChunkCount(data.size());
+    std::vector<size_t> chunk_starts(chunk_count + 1, data.size());
+    chunk_starts[0] = 0;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        const size_t line_end = data.find('\n', std::max(chunk_starts[i - 1], i * data.size() / chunk_count));
+        chunk_starts[i] = line_end == std::string_view::npos ? data.size() : line_end + 1;
+    }
+
+    std::vector<std::vector<std::string_view>> chunk_lines(chunk_count);
+    std::vector<size_t> chunk_indexes(chunk_count);
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+    std::for_each(std::execution::par, chunk_indexes.begin(), chunk_indexes.end(),
+        [data, &chunk_starts, &chunk_lines](size_t index) {
+            std::string_view chunk = data.substr(chunk_starts[index], chunk_starts[index + 1] - chunk_starts[index]);
+            while (!chunk.empty()) {
+                const size_t line_end = std::min(chunk.find('\n'), chunk.size());
+                std::string_view line = chunk.substr(0, line_end);
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                chunk_lines[index].push_back(line);
+                chunk.remove_prefix(std::min(line_end + 1, chunk.size()));
+            }
+        });
+    return chunk_lines;
+}
+
+template <typename Value>
+Value ReadRecordValue(std::string_view& data) {
+    Value value;
+    if (data.size() < sizeof(value)) {
+        throw std::invalid_argument("обрезанная запись корпуса"s);
+    }
+    std::memcpy(&value, data.data(), sizeof(value));
+    data.remove_prefix(sizeof(value));
+    return value;
+}
+
+// Записи разбираются последовательно: начало записи известно только после чтения предыдущей.
+// Заголовки короткие, основное время занимает разбор текстов
+std::vector<CorpusRecord> SplitIntoRecords(std::string_view data) {
+    std::vector<CorpusRecord> records;
+    while (!data.empty()) {
+        CorpusRecord record;
+        record.document_id = ReadRecordValue<int32_t>(data);
+        const int32_t status = ReadRecordValue<int32_t>(data);
+        if (status < static_cast<int32_t>(DocumentStatus::ACTUAL) || status > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+            throw std::invalid_argument("недопустимый статус в записи корпуса"s);
+        }
+        record.status = static_cast<DocumentStatus>(status);
+        const uint32_t rating_count = ReadRecordValue<uint32_t>(data);
+        if (rating_count > data.size() / sizeof(int32_t)) {
+            throw std::invalid_argument("обрезанная запись корпуса"s);
+        }
+        record.ratings.reserve(rating_count);
+        for (uint32_t i = 0; i < rating_count; ++i) {
+            record.ratings.push_back(ReadRecordValue<int32_t>(data));
+        }
+        const uint32_t text_size = ReadRecordValue<uint32_t>(data);
+        if (text_size > data.size()) {
+            throw std::invalid_argument("обрезанная запись корпуса"s);
+        }
+        record.text = data.substr(0, text_size);
+        data.remove_prefix(text_size);
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+// Вызывает function(index) для частей [0, chunk_count) параллельно и передаёт вызывающему первое исключение
+template <typename Function>
+void ForEachChunk(size_t chunk_count, Function function) {
+    std::vector<size_t> chunk_indexes(chunk_count);
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+    std::vector<std::exception_ptr> exceptions(chunk_count);
+    std::for_each(std::execution::par, chunk_indexes.begin(), chunk_indexes.end(),
+        [&function, &exceptions](size_t index) {
+            try {
+                function(index);
+            }
+            catch (...) {
+                exceptions[index] = std::current_exception();
+            }
+        });
+    for (const std::exception_ptr& exception : exceptions) {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
+
+std::vector<PreparedDocument> PrepareLines(const SearchServer& search_server, std::string_view data,
+    const std::shared_ptr<const MappedFile>& file, int first_document_id) {
+    const std::vector<std::vector<std::string_view>> chunk_lines = SplitIntoLines(data);
+    std::vector<size_t> chunk_offsets(chunk_lines.size() + 1, 0);
+    for (size_t i = 0; i < chunk_lines.size(); ++i) {
+        chunk_offsets[i + 1] = chunk_offsets[i] + chunk_lines[i].size();
+    }
+
+    std::vector<PreparedDocument> documents(chunk_offsets.back());
+    ForEachChunk(chunk_lines.size(), [&](size_t index) {
+        for (size_t i = 0; i < chunk_lines[index].size(); ++i) {
+            const size_t position = chunk_offsets[index] + i;
+            documents[position] = search_server.PrepareDocument(first_document_id + static_cast<int>(position),
+                chunk_lines[index][i], DocumentStatus::ACTUAL, {}, file);
+        }
+    });
+    return documents;
+}
+
+std::vector<PreparedDocument> PrepareRecords(const SearchServer& search_server, std::string_view data,
+    const std::shared_ptr<const MappedFile>& file) {
+    const std::vector<CorpusRecord> records = SplitIntoRecords(data);
+    const size_t chunk_count = std::min(GetChunkCount(data.size()), std::max<size_t>(1, records.size()));
+
+    std::vector<PreparedDocument> documents(records.size());
+    ForEachChunk(chunk_count, [&](size_t index) {
+        const size_t end = (index + 1) * records.size() / chunk_count;
+        for (size_t i = index * records.size() / chunk_count; i < end; ++i) {
+            const CorpusRecord& record = records[i];
+            documents[i] = search_server.PrepareDocument(record.document_id, record.text, record.status, record.ratings, file);
+        }
+    });
+    return documents;
+}
+
+} // namespace
+
+double CorpusLoadStatistics::GetGigabytesPerSecond() const {
+    if (duration.count() == 0) {
+        return 0.0;
+    }
+    // байты в наносекунду равны гигабайтам в секунду
+    return static_cast<double>(byte_count) / duration.count();
+}
+
+CorpusLoadStatistics LoadCorpus(SearchServer& search_server, const std::string& path, CorpusFormat format, int first_document_id) {
+    const auto start_time = std::chrono::steady_clock::now();
+
+    const auto file = std::make_shared<const MappedFile>(path);
+    const std::string_view data = file->GetData();
+    std::vector<PreparedDocument> documents = format == CorpusFormat::LINES
+        ? PrepareLines(search_server, data, file, first_document_id)
+        : PrepareRecords(search_server, data, file);
+
+    CorpusLoadStatistics statistics;
+    statistics.document_count = documents.size();
+    statistics.byte_count = data.size();
+    search_server.AddDocuments(std::execution::par, std::move(documents));
+    statistics.duration = std::chrono::steady_clock::now() - start_time;
+    return statistics;
+}
+
+void WriteCorpusRecord(std::ostream& out, int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    const auto write_value = [&out](auto value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    write_value(static_cast<int32_t>(document_id));
+    write_value(static_cast<int32_t>(status));
+    write_value(static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        write_value(static_cast<int32_t>(rating));
+    }
+    write_value(static_cast<uint32_t>(document.size()));
+    out.write(document.data(), static_cast<std::streamsize>(document.size()));
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class CorpusFormat {
+    // документ на строку; id идут подряд начиная с first_document_id, статус ACTUAL, оценок нет
+    LINES,
+    // записи из id, статуса, числа оценок, оценок, длины текста и текста.
+    // Числа 32-битные в порядке байтов машины, см. WriteCorpusRecord
+    RECORDS
+};
+
+struct CorpusLoadStatistics {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    // от открытия файла до появления документов в индексе
+    std::chrono::nanoseconds duration{};
+
+    double GetGigabytesPerSecond() const;
+};
+
+/**
+ * Добавляет в сервер документы из файла корпуса.
+ *
+ * Файл отображается в память, тексты документов не копируются: при разборе слова
+ * ссылаются прямо на отображение, а в словарь индекса попадает по одной копии
+ * каждого нового слова. Отображение освобождается сразу после добавления документов,
+ * до этого файл нельзя изменять.
+ * Файл делится на части по границам документов, части разбираются параллельно,
+ * затем документы добавляются одним пакетом. При ошибке в любом документе
+ * не добавляется ни один.
+ *
+ * Пример использования:
+ *
+ *  SearchServer search_server("and with"s);
+ *  const auto statistics = LoadCorpus(search_server, "corpus.txt"s, CorpusFormat::LINES);
+ *  std::cout << statistics.GetGigabytesPerSecond() << " GB/s"s << std::endl;
+ */
+CorpusLoadStatistics LoadCorpus(SearchServer& search_server, const std::string& path, CorpusFormat format, int first_document_id = 0);
+
+// Записывает документ в формате CorpusFormat::RECORDS
+void WriteCorpusRecord(std::ostream& out, int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
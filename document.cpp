@@ -2,10 +2,23 @@
 
 using namespace std::string_literals;
 
+PackedDocument::PackedDocument(const Document& document)
+    : id(document.id), relevance(static_cast<float>(document.relevance)), rating(document.rating)
+{
+}
+
 std::ostream& operator<<(std::ostream& out, const Document& document) {
     out << "{ "s
         << "document_id = "s << document.id << ", "s
         << "relevance = "s << document.relevance << ", "s
         << "rating = "s << document.rating << " }"s;
     return out;
+}
+
+std::ostream& operator<<(std::ostream& out, const PackedDocument& document) {
+    out << "{ "s
+        << "document_id = "s << document.id << ", "s
+        << "relevance = "s << document.relevance << ", "s
+        << "rating = "s << document.rating << " }"s;
+    return out;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -17,6 +18,18 @@ struct Document {
     int rating = 0;
 };
 
+// Компактная запись результата поиска: 12 байт вместо 16 у Document.
+// Точности float хватает для сравнения релевантности с EPSILON
+struct PackedDocument {
+    PackedDocument() = default;
+
+    explicit PackedDocument(const Document& document);
+
+    int32_t id = 0;
+    float relevance = 0.0f;
+    int32_t rating = 0;
+};
+
 enum class DocumentStatus {
     ACTUAL,
     IRRELEVANT,
@@ -24,4 +37,5 @@ enum class DocumentStatus {
     REMOVED
 };
 
-std::ostream& operator<<(std::ostream& out, const Document& document);
\ No newline at end of file
+std::ostream& operator<<(std::ostream& out, const Document& document);
+std::ostream& operator<<(std::ostream& out, const PackedDocument& document);
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "fuzzy_term_index.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <string>
+
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance) {
+    if (lhs.size() > rhs.size()) {
+        std::swap(lhs, rhs);
+    }
+    if (rhs.size() - lhs.size() > static_cast<size_t>(max_distance)) {
+        return max_distance + 1;
+    }
+
+    // Три последние строки таблицы: перестановка соседних символов смотрит на две строки назад.
+    // Для коротких слов строки лежат на стеке, поэтому проверка кандидата не выделяет память
+    static constexpr size_t MAX_STACK_WORD_SIZE = 31;
+    std::array<int, 3 * (MAX_STACK_WORD_SIZE + 1)> stack_rows;
+    std::vector<int> heap_rows;
+    int* rows = stack_rows.data();
+    if (rhs.size() > MAX_STACK_WORD_SIZE) {
+        heap_rows.resize(3 * (rhs.size() + 1));
+        rows = heap_rows.data();
+    }
+    int* before_previous = rows;
+    int* previous = rows + rhs.size() + 1;
+    int* current = rows + 2 * (rhs.size() + 1);
+    std::iota(previous, previous + rhs.size() + 1, 0);
+    for (size_t i = 1; i <= lhs.size(); ++i) {
+        current[0] = static_cast<int>(i);
+        int row_min = current[0];
+        for (size_t j = 1; j <= rhs.size(); ++j) {
+            const int substitution_cost = lhs[i - 1] == rhs[j - 1] ? 0 : 1;
+            current[j] = std::min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + substitution_cost });
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1]) {
+                current[j] = std::min(current[j], before_previous[j - 2] + 1);
+            }
+            row_min = std::min(row_min, current[j]);
+        }
+        // Значения в следующих строках не меньше минимума текущей
+        if (row_min > max_distance) {
+            return max_distance + 1;
+        }
+        std::swap(before_previous, previous);
+        std::swap(previous, current);
+    }
+    return std::min(previous[rhs.size()], max_distance + 1);
+}
+
+FuzzyTermIndex::FuzzyTermIndex(int max_distance, const CountingAllocator<char>& allocator)
+    : max_distance_(max_distance)
+    , deletions_(0, allocator)
+{
+}
+
+int FuzzyTermIndex::GetMaxDistance() const noexcept {
+    return max_distance_;
+}
+
+void FuzzyTermIndex::AddTerm(uint32_t term_id, std::string_view word) {
+    for (const uint64_t hash : HashDeletions(word)) {
+        deletions_.emplace(hash, term_id);
+    }
+}
+
+void FuzzyTermIndex::RemoveTerm(uint32_t term_id, std::string_view word) {
+    for (const uint64_t hash : HashDeletions(word)) {
+        auto [first, last] = deletions_.equal_range(hash);
+        const auto it = std::find_if(first, last, [term_id](const auto& entry) {
+            return entry.second == term_id;
+        });
+        if (it != last) {
+            deletions_.erase(it);
+        }
+    }
+}
+
+void FuzzyTermIndex::FindCandidates(std::string_view word, std::vector<uint32_t>& term_ids) const {
+    for (const uint64_t hash : HashDeletions(word)) {
+        const auto [first, last] = deletions_.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            term_ids.push_back(it->second);
+        }
+    }
+}
+
+std::vector<uint64_t> FuzzyTermIndex::HashDeletions(std::string_view word) const {
+    // Удаления строятся по уровням: строки уровня k получаются удалением символа из строк уровня k - 1
+    std::vector<std::string> deletions{ std::string(word) };
+    size_t level_begin = 0;
+    for (int distance = 1; distance <= max_distance_; ++distance) {
+        const size_t level_end = deletions.size();
+        for (size_t i = level_begin; i < level_end; ++i) {
+            for (size_t position = 0; position < deletions[i].size(); ++position) {
+                std::string deletion = deletions[i];
+                deletion.erase(position, 1);
+                deletions.push_back(std::move(deletion));
+            }
+        }
+        // Повторы внутри уровня отбрасываются, чтобы следующий уровень не рос лишний раз
+        std::sort(deletions.begin() + level_end, deletions.end());
+        deletions.erase(std::unique(deletions.begin() + level_end, deletions.end()), deletions.end());
+        level_begin = level_end;
+    }
+
+    std::vector<uint64_t> hashes;
+    hashes.reserve(deletions.size());
+    for (const std::string& deletion : deletions) {
+        hashes.push_back(std::hash<std::string_view>{}(deletion));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "memory_accounting.h"
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Расстояние Дамерау — Левенштейна (вставки, удаления, замены и перестановки соседних символов)
+// между lhs и rhs, если оно не больше max_distance, иначе max_distance + 1
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance);
+
+/**
+ * Индекс удалений для поиска слов словаря с опечатками (как в SymSpell).
+ *
+ * Для каждого слова хранятся строки, получаемые из него удалением не больше max_distance символов.
+ * У слов на расстоянии не больше max_distance есть общая строка удалений, поэтому кандидаты
+ * находятся поиском удалений слова запроса, а не перебором словаря. Строки хранятся 64-битными
+ * хешами: совпадение хешей лишь добавляет кандидата, а расстояние до кандидатов всё равно проверяется.
+ *
+ * Пример использования:
+ *
+ *  FuzzyTermIndex index(1, allocator);
+ *  index.AddTerm(0, "curly"sv);
+ *  std::vector<uint32_t> term_ids;
+ *  index.FindCandidates("curyl"sv, term_ids); // { 0 }
+ */
+class FuzzyTermIndex {
+public:
+    FuzzyTermIndex(int max_distance, const CountingAllocator<char>& allocator);
+
+    int GetMaxDistance() const noexcept;
+
+    void AddTerm(uint32_t term_id, std::string_view word);
+
+    // word — слово, с которым term_id был добавлен
+    void RemoveTerm(uint32_t term_id, std::string_view word);
+
+    // Дописывает в term_ids номера слов, у которых есть общая с word строка удалений.
+    // Номера могут повторяться, а расстояние до слов нужно проверить
+    void FindCandidates(std::string_view word, std::vector<uint32_t>& term_ids) const;
+
+private:
+    using Deletions = std::unordered_multimap<uint64_t, uint32_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+        CountingAllocator<std::pair<const uint64_t, uint32_t>>>;
+
+    int max_distance_;
+    // хеш строки удалений → номер слова
+    Deletions deletions_;
+
+    // Хеши строк, получаемых из word удалением не больше max_distance символов, включая само слово, без повторов
+    std::vector<uint64_t> HashDeletions(std::string_view word) const;
+};
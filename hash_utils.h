@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Перемешивает биты значения (финализатор splitmix64). Близкие значения, например
+// последовательные id, дают далёкие хеши, поэтому младшие биты хеша распределены равномерно
+inline uint64_t MixHash(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
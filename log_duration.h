@@ -11,6 +11,8 @@
 /**
  * Макрос замеряет время, прошедшее с момента своего вызова
  * до конца текущего блока, и выводит в поток std::cerr.
+ * Для часто вызываемого кода используйте PROFILE_SCOPE из profiler.h:
+ * он не выводит каждый замер, а собирает их в гистограмму.
  *
  * Пример использования:
  *
@@ -1,15 +1,72 @@
+#include "benchmark.h"
 #include "process_queries.h"
 #include "search_server.h"
 #include "test_example_functions.h"
+#include "tests.h"
 
 #include <execution>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
 
-int main() {
+// Запуск замеров: main --benchmark [--documents=N] [--queries=N] [--repetitions=N] [--threads=N] [--seed=N] [--filter=ИМЯ]
+// С --soft-stop-ratio=R вместо замеров сравниваются результаты поиска с пропуском частых слов и без него
+int RunBenchmarkCommand(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    optional<double> soft_stop_ratio;
+    for (int i = 2; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t separator = argument.find('=');
+        const string_view name = argument.substr(0, separator);
+        const string value(separator == string_view::npos ? ""sv : argument.substr(separator + 1));
+        if (name == "--documents"sv) {
+            options.corpus.document_count = stoull(value);
+        }
+        else if (name == "--queries"sv) {
+            options.queries.query_count = stoull(value);
+        }
+        else if (name == "--repetitions"sv) {
+            options.repetitions = stoull(value);
+        }
+        else if (name == "--threads"sv) {
+            options.thread_count = stoull(value);
+        }
+        else if (name == "--seed"sv) {
+            options.corpus.seed = stoull(value);
+            options.queries.seed = options.corpus.seed + 1;
+        }
+        else if (name == "--filter"sv) {
+            options.filter = value;
+        }
+        else if (name == "--soft-stop-ratio"sv) {
+            soft_stop_ratio = stod(value);
+        }
+        else {
+            cerr << "Unknown option "s << argument << endl;
+            return 1;
+        }
+    }
+    if (soft_stop_ratio) {
+        PrintJson(cout, CompareSoftStopWords(options, *soft_stop_ratio));
+        return 0;
+    }
+    PrintJson(cout, options, RunBenchmarks(options));
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && argv[1] == "--benchmark"sv) {
+        return RunBenchmarkCommand(argc, argv);
+    }
+    // Модульные тесты: main --test
+    if (argc > 1 && argv[1] == "--test"sv) {
+        RunTests();
+        return 0;
+    }
     SearchServer search_server("and with"s);
     int id = 0;
     for (
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+// Число байтов, выделенных через CountingAllocator и ещё не освобождённых
+using MemoryCounter = std::atomic<size_t>;
+
+/**
+ * Аллокатор, учитывающий выделенную память в общем счётчике.
+ *
+ * Память берётся у std::allocator. Копии аллокатора, в том числе перепривязанные
+ * к другому типу, ведут учёт в том же счётчике, поэтому в него попадают и узлы
+ * контейнера, и блоки управления std::allocate_shared. Счётчик живёт, пока жив
+ * хотя бы один аллокатор, так что память можно освобождать после удаления владельца счётчика.
+ *
+ * Пример использования:
+ *
+ *  auto counter = std::make_shared<MemoryCounter>(0);
+ *  std::vector<int, CountingAllocator<int>> numbers{ CountingAllocator<int>(counter) };
+ *  numbers.reserve(100);
+ *  std::cout << counter->load() << std::endl; // 400
+ */
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit CountingAllocator(std::shared_ptr<MemoryCounter> counter) noexcept
+        : counter_(std::move(counter))
+    {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.GetCounter())
+    {
+    }
+
+    T* allocate(size_t count) {
+        T* const data = std::allocator<T>().allocate(count);
+        counter_->fetch_add(count * sizeof(T), std::memory_order_relaxed);
+        return data;
+    }
+
+    void deallocate(T* data, size_t count) noexcept {
+        counter_->fetch_sub(count * sizeof(T), std::memory_order_relaxed);
+        std::allocator<T>().deallocate(data, count);
+    }
+
+    const std::shared_ptr<MemoryCounter>& GetCounter() const noexcept {
+        return counter_;
+    }
+
+private:
+    std::shared_ptr<MemoryCounter> counter_;
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+// Строка, память которой учитывается в счётчике
+using CountedString = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
@@ -3,6 +3,12 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 template <typename Iterator>
 class IteratorRange {
@@ -70,4 +76,106 @@ private:
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
+
+/**
+ * Ленивый постраничный обход: страницы запрашиваются у fetch_page по мере продвижения итератора,
+ * пустая страница означает конец. Обойти страницы можно только один раз.
+ *
+ * Пример использования:
+ *
+ *  for (const auto& page : PaginateSearch(search_server, "curly cat"s, 10)) {
+ *      ... // page — вектор документов очередной страницы
+ *  }
+ */
+template <typename PageFetcher>
+class LazyPaginator {
+public:
+    using Page = std::invoke_result_t<PageFetcher&>;
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Page;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Page*;
+        using reference = const Page&;
+
+        // итератор конца
+        Iterator() = default;
+
+        explicit Iterator(LazyPaginator* paginator)
+            : paginator_(paginator) {
+            FetchPage();
+        }
+
+        reference operator*() const {
+            return page_;
+        }
+
+        pointer operator->() const {
+            return &page_;
+        }
+
+        Iterator& operator++() {
+            FetchPage();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return paginator_ == other.paginator_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        LazyPaginator* paginator_ = nullptr;
+        Page page_;
+
+        void FetchPage() {
+            page_ = paginator_->fetch_page_();
+            if (page_.empty()) {
+                paginator_ = nullptr;
+            }
+        }
+    };
+
+    explicit LazyPaginator(PageFetcher fetch_page)
+        : fetch_page_(std::move(fetch_page)) {
+    }
+
+    Iterator begin() {
+        return Iterator(this);
+    }
+
+    Iterator end() {
+        return {};
+    }
+
+private:
+    PageFetcher fetch_page_;
+};
+
+template <typename PageFetcher>
+auto PaginateLazily(PageFetcher fetch_page) {
+    return LazyPaginator<PageFetcher>(std::move(fetch_page));
+}
+
+// Страницы результатов поиска по курсору: каждая страница — отдельный запрос к серверу,
+// поэтому время получения страницы не растёт с её номером
+template <typename Server>
+auto PaginateSearch(const Server& search_server, std::string raw_query, size_t page_size) {
+    using Cursor = typename decltype(search_server.FindTopDocuments(raw_query, page_size, {}).next_cursor)::value_type;
+    return PaginateLazily(
+        [&search_server, raw_query = std::move(raw_query), page_size, cursor = std::optional<Cursor>{}, is_finished = false]() mutable {
+            if (is_finished) {
+                return decltype(search_server.FindTopDocuments(raw_query, page_size, cursor).documents){};
+            }
+            auto page = search_server.FindTopDocuments(raw_query, page_size, cursor);
+            cursor = page.next_cursor;
+            is_finished = !cursor;
+            return std::move(page.documents);
+        });
+}
@@ -1,17 +1,119 @@
 #include "process_queries.h"
 
-std::vector<std::vector<Document>> ProcessQueries(
-	const SearchServer& search_server, 
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+namespace {
+
+// Выполняет запрос index в его ячейку из MAX_RESULT_DOCUMENT_COUNT документов
+// и записывает число найденных в offsets[index + 1]
+void ProcessPackedQuery(const SearchServer& search_server, const std::vector<std::string>& queries,
+	PackedQueryResults& results, size_t index) {
+	// буфер живёт вместе с потоком исполнителя и переиспользуется всеми его запросами
+	thread_local SearchResultBuffer buffer;
+	results.offsets[index + 1] = search_server.FindTopDocuments(queries[index], buffer,
+		results.documents.data() + index * MAX_RESULT_DOCUMENT_COUNT, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+// Сдвигает результаты запросов из ячеек вплотную друг к другу.
+// Документ сдвигается только к началу, поэтому ещё не сдвинутые не затираются
+void CompactPackedResults(PackedQueryResults& results) {
+	results.offsets[0] = 0;
+	for (size_t index = 0; index + 1 < results.offsets.size(); ++index) {
+		const size_t count = results.offsets[index + 1];
+		const size_t source = index * MAX_RESULT_DOCUMENT_COUNT;
+		const size_t destination = results.offsets[index];
+		if (destination != source) {
+			std::copy(results.documents.begin() + source, results.documents.begin() + source + count,
+				results.documents.begin() + destination);
+		}
+		results.offsets[index + 1] = destination + count;
+	}
+	results.documents.resize(results.offsets.back());
+}
+
+// Вызывает process_query(index) для каждого запроса: на пуле или параллельным алгоритмом
+// по вектору индексов. Запросы выполняются в других потоках, поэтому статистика каждого
+// собирается отдельно и складывается в сборщик вызывающего потока, если он задан
+template <typename Executor, typename ProcessQuery>
+void ForEachQuery(Executor& executor, size_t query_count, ProcessQuery process_query) {
+	QueryStats* const batch_stats = QueryStatsCollector::GetCurrent();
+	std::vector<QueryStats> query_stats(batch_stats ? query_count : 0);
+	const auto process_with_stats = [&query_stats, &process_query](size_t index) {
+		if (query_stats.empty()) {
+			process_query(index);
+			return;
+		}
+		QueryStatsCollector collector(query_stats[index]);
+		process_query(index);
+	};
+
+	if constexpr (std::is_same_v<std::decay_t<Executor>, ThreadPool>) {
+		executor.ParallelFor(query_count, process_with_stats);
+	}
+	else {
+		std::vector<size_t> indexes(query_count);
+		std::iota(indexes.begin(), indexes.end(), 0);
+		std::for_each(executor, indexes.begin(), indexes.end(), process_with_stats);
+	}
+
+	for (const QueryStats& stats : query_stats) {
+		*batch_stats += stats;
+	}
+}
+
+template <typename Executor>
+std::vector<std::vector<Document>> ProcessQueriesOn(Executor& executor, const SearchServer& search_server,
 	const std::vector<std::string>& queries) {
 	std::vector<std::vector<Document>> documents_lists(queries.size());
+	// запросы независимы, поэтому каждый выполняется последовательно
+	// на том потоке, который его взял
+	ForEachQuery(executor, queries.size(), [&search_server, &queries, &documents_lists](size_t index) {
+		documents_lists[index] = search_server.FindTopDocuments(queries[index]);
+	});
+	return documents_lists;
+}
 
-	std::transform(std::execution::par,
-				   queries.begin(), queries.end(),
-				   documents_lists.begin(), [&search_server](const std::string& query) { 
-											 return search_server.FindTopDocuments(query); 
-		});
+template <typename Executor>
+void ProcessPackedQueries(Executor& executor, const SearchServer& search_server, const std::vector<std::string>& queries,
+	PackedQueryResults& results) {
+	results.documents.resize(queries.size() * MAX_RESULT_DOCUMENT_COUNT);
+	results.offsets.resize(queries.size() + 1);
+	ForEachQuery(executor, queries.size(), [&search_server, &queries, &results](size_t index) {
+		ProcessPackedQuery(search_server, queries, results, index);
+	});
+	CompactPackedResults(results);
+}
 
-	return documents_lists;
+} // namespace
+
+std::vector<std::vector<Document>> ProcessQueries(
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries) {
+	return ProcessQueriesOn(std::execution::par, search_server, queries);
+}
+
+std::vector<std::vector<Document>> ProcessQueries(
+	ThreadPool& pool,
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries) {
+	return ProcessQueriesOn(pool, search_server, queries);
+}
+
+void ProcessQueries(
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries,
+	PackedQueryResults& results) {
+	ProcessPackedQueries(std::execution::par, search_server, queries, results);
+}
+
+void ProcessQueries(
+	ThreadPool& pool,
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries,
+	PackedQueryResults& results) {
+	ProcessPackedQueries(pool, search_server, queries, results);
 }
 
 std::vector<Document> ProcessQueriesJoined(
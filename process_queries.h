@@ -1,11 +1,29 @@
 #pragma once
 
 #include "document.h"
+#include "query_stats.h"
 #include "search_server.h"
+#include "thread_pool.h"
 
 #include <vector>
 #include <execution>
 
+// Если в вызывающем потоке задан QueryStatsCollector, в него складывается статистика всех запросов
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
+std::vector<std::vector<Document>> ProcessQueries(ThreadPool& pool, const SearchServer& search_server, const std::vector<std::string>& queries);
+
+// Результаты пакета запросов в одном массиве: документы запроса i занимают
+// documents[offsets[i]] .. documents[offsets[i + 1] - 1]
+struct PackedQueryResults {
+    std::vector<PackedDocument> documents;
+    std::vector<size_t> offsets;
+};
+
+// Заполняет results, сохраняя выделенную в нём память. Если results переиспользуется
+// между пакетами, результаты запросов не выделяют память
+void ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries, PackedQueryResults& results);
+
+void ProcessQueries(ThreadPool& pool, const SearchServer& search_server, const std::vector<std::string>& queries, PackedQueryResults& results);
+
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// Логарифмически-линейная гистограмма: значения меньше SUB_BUCKET_COUNT хранятся точно,
+// каждый следующий интервал [2^k, 2^(k+1)) делится на SUB_BUCKET_COUNT равных частей
+constexpr int SUB_BUCKET_BITS = 5;
+constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+int GetHighestBit(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+size_t GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    const int exponent = GetHighestBit(value);
+    const uint64_t sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT;
+    return static_cast<size_t>((exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket);
+}
+
+uint64_t GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int exponent = static_cast<int>(index / SUB_BUCKET_COUNT) - 1 + SUB_BUCKET_BITS;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+    const uint64_t lower_bound = (SUB_BUCKET_COUNT + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+    return lower_bound + ((uint64_t{ 1 } << (exponent - SUB_BUCKET_BITS)) - 1);
+}
+
+// Гистограмма одного места замера в одном потоке. Пишет в неё только поток-владелец,
+// поэтому счётчики увеличиваются без атомарных операций чтения-изменения-записи
+struct SiteHistogram {
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> total_ticks = 0;
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+
+    void Add(uint64_t ticks) noexcept {
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total_ticks.store(total_ticks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+        auto& bucket = buckets[GetBucketIndex(ticks)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+// Сумма гистограмм для построения статистики и для завершившихся потоков
+struct SiteTotals {
+    uint64_t count = 0;
+    uint64_t total_ticks = 0;
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKET_COUNT);
+
+    void Add(const SiteHistogram& histogram) {
+        count += histogram.count.load(std::memory_order_relaxed);
+        total_ticks += histogram.total_ticks.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void Add(const SiteTotals& totals) {
+        count += totals.count;
+        total_ticks += totals.total_ticks;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            buckets[i] += totals.buckets[i];
+        }
+    }
+};
+
+struct ThreadProfile;
+
+struct ProfileRegistry {
+    std::mutex mutex;
+    std::vector<std::string> site_names;
+    std::vector<ThreadProfile*> thread_profiles;
+    std::vector<SiteTotals> finished_thread_totals;
+    // Точка отсчёта для перевода тактов в наносекунды
+    const uint64_t start_ticks = ReadProfileTicks();
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+};
+
+// Реестр не разрушается, чтобы потоки, завершающиеся после main, могли сдать в него статистику
+ProfileRegistry& GetRegistry() {
+    static ProfileRegistry* registry = new ProfileRegistry;
+    return *registry;
+}
+
+struct ThreadProfile {
+    // Гистограммы по номерам мест замера. Вектор меняется только под мьютексом реестра
+    std::vector<std::unique_ptr<SiteHistogram>> sites;
+
+    ThreadProfile() {
+        ProfileRegistry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.thread_profiles.push_back(this);
+    }
+
+    ~ThreadProfile() {
+        ProfileRegistry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        for (size_t site_id = 0; site_id < sites.size(); ++site_id) {
+            if (sites[site_id]) {
+                registry.finished_thread_totals[site_id].Add(*sites[site_id]);
+            }
+        }
+        registry.thread_profiles.erase(
+            std::find(registry.thread_profiles.begin(), registry.thread_profiles.end(), this));
+    }
+
+    SiteHistogram& AddSite(size_t site_id) {
+        std::lock_guard guard(GetRegistry().mutex);
+        if (sites.size() <= site_id) {
+            sites.resize(site_id + 1);
+        }
+        sites[site_id] = std::make_unique<SiteHistogram>();
+        return *sites[site_id];
+    }
+};
+
+thread_local ThreadProfile thread_profile;
+
+std::chrono::nanoseconds TicksToDuration(uint64_t ticks, double nanoseconds_per_tick) {
+    return std::chrono::nanoseconds(static_cast<int64_t>(ticks * nanoseconds_per_tick));
+}
+
+} // namespace
+
+size_t RegisterProfileSite(std::string_view name) {
+    ProfileRegistry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    const auto it = std::find(registry.site_names.begin(), registry.site_names.end(), name);
+    if (it != registry.site_names.end()) {
+        return static_cast<size_t>(it - registry.site_names.begin());
+    }
+    registry.site_names.emplace_back(name);
+    registry.finished_thread_totals.emplace_back();
+    return registry.site_names.size() - 1;
+}
+
+void AddProfileSample(size_t site_id, uint64_t ticks) noexcept {
+    auto& sites = thread_profile.sites;
+    if (site_id < sites.size() && sites[site_id]) {
+        sites[site_id]->Add(ticks);
+        return;
+    }
+    try {
+        thread_profile.AddSite(site_id).Add(ticks);
+    }
+    catch (...) {
+        // Без памяти под гистограмму замер теряется
+    }
+}
+
+std::vector<ProfileSiteStatistics> GetProfileStatistics() {
+    ProfileRegistry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+
+    double nanoseconds_per_tick = 1.0;
+#if defined(__x86_64__) || defined(_M_X64)
+    const uint64_t elapsed_ticks = ReadProfileTicks() - registry.start_ticks;
+    const auto elapsed_time = std::chrono::steady_clock::now() - registry.start_time;
+    if (elapsed_ticks > 0) {
+        nanoseconds_per_tick = std::chrono::duration<double, std::nano>(elapsed_time).count() / elapsed_ticks;
+    }
+#endif
+
+    std::vector<ProfileSiteStatistics> result;
+    result.reserve(registry.site_names.size());
+    for (size_t site_id = 0; site_id < registry.site_names.size(); ++site_id) {
+        SiteTotals totals;
+        totals.Add(registry.finished_thread_totals[site_id]);
+        for (const ThreadProfile* thread_profile : registry.thread_profiles) {
+            if (site_id < thread_profile->sites.size() && thread_profile->sites[site_id]) {
+                totals.Add(*thread_profile->sites[site_id]);
+            }
+        }
+
+        ProfileSiteStatistics statistics;
+        statistics.name = registry.site_names[site_id];
+        statistics.count = totals.count;
+        if (totals.count > 0) {
+            statistics.mean = TicksToDuration(totals.total_ticks / totals.count, nanoseconds_per_tick);
+
+            const std::pair<double, std::chrono::nanoseconds*> quantiles[] = {
+                { 0.5, &statistics.p50 }, { 0.9, &statistics.p90 }, { 0.99, &statistics.p99 }, { 0.999, &statistics.p999 }
+            };
+            size_t quantile_index = 0;
+            uint64_t cumulative_count = 0;
+            for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                if (totals.buckets[i] == 0) {
+                    continue;
+                }
+                cumulative_count += totals.buckets[i];
+                while (quantile_index < std::size(quantiles)
+                    && cumulative_count >= quantiles[quantile_index].first * totals.count) {
+                    *quantiles[quantile_index++].second = TicksToDuration(GetBucketUpperBound(i), nanoseconds_per_tick);
+                }
+                statistics.max = TicksToDuration(GetBucketUpperBound(i), nanoseconds_per_tick);
+            }
+        }
+        result.push_back(std::move(statistics));
+    }
+    return result;
+}
+
+void PrintProfileStatistics(std::ostream& out) {
+    out << std::left << std::setw(32) << "site" << std::right
+        << std::setw(12) << "count" << std::setw(12) << "mean ns" << std::setw(12) << "p50 ns"
+        << std::setw(12) << "p90 ns" << std::setw(12) << "p99 ns" << std::setw(12) << "p999 ns"
+        << std::setw(12) << "max ns" << '\n';
+    for (const ProfileSiteStatistics& statistics : GetProfileStatistics()) {
+        out << std::left << std::setw(32) << statistics.name << std::right
+            << std::setw(12) << statistics.count << std::setw(12) << statistics.mean.count()
+            << std::setw(12) << statistics.p50.count() << std::setw(12) << statistics.p90.count()
+            << std::setw(12) << statistics.p99.count() << std::setw(12) << statistics.p999.count()
+            << std::setw(12) << statistics.max.count() << '\n';
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "log_duration.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+/**
+ * Макрос замеряет время от своего вызова до конца текущего блока и добавляет его
+ * в гистограмму места замера. В отличие от LOG_DURATION ничего не выводит:
+ * замер стоит несколько наносекунд, и его можно оставлять в часто вызываемом коде.
+ * Замеры с одинаковым именем попадают в одну гистограмму.
+ *
+ * Пример использования:
+ *
+ *  void ParseQuery() {
+ *      PROFILE_SCOPE("ParseQuery");
+ *      ...
+ *  }
+ *
+ *  int main() {
+ *      ...
+ *      PrintProfileStatistics(std::cerr);
+ *  }
+ */
+#define PROFILE_SCOPE(name) \
+    static const size_t PROFILE_CONCAT(profileSite, __LINE__) = RegisterProfileSite(name); \
+    ProfileScope UNIQUE_VAR_NAME_PROFILE(PROFILE_CONCAT(profileSite, __LINE__))
+
+struct ProfileSiteStatistics {
+    std::string name;
+    uint64_t count = 0;
+    std::chrono::nanoseconds mean{};
+    // Квантили и максимум — верхние границы интервалов гистограммы, погрешность до 1/32
+    std::chrono::nanoseconds p50{};
+    std::chrono::nanoseconds p90{};
+    std::chrono::nanoseconds p99{};
+    std::chrono::nanoseconds p999{};
+    std::chrono::nanoseconds max{};
+};
+
+// Возвращает номер места замера с данным именем, при первом обращении регистрирует его
+size_t RegisterProfileSite(std::string_view name);
+
+// Записывает длительность в тактах ReadProfileTicks в гистограмму места замера текущего потока
+void AddProfileSample(size_t site_id, uint64_t ticks) noexcept;
+
+// Статистика всех мест замера по всем потокам, включая завершившиеся
+std::vector<ProfileSiteStatistics> GetProfileStatistics();
+
+void PrintProfileStatistics(std::ostream& out);
+
+// Такты счётчика процессора на x86-64, на остальных платформах — наносекунды steady_clock.
+// Такты переводятся в наносекунды при построении статистики
+inline uint64_t ReadProfileTicks() noexcept {
+#if defined(__x86_64__) || defined(_M_X64)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+class ProfileScope {
+public:
+    explicit ProfileScope(size_t site_id) noexcept
+        : site_id_(site_id)
+        , start_ticks_(ReadProfileTicks()) {
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope() {
+        AddProfileSample(site_id_, ReadProfileTicks() - start_ticks_);
+    }
+
+private:
+    const size_t site_id_;
+    const uint64_t start_ticks_;
+};
@@ -0,0 +1,74 @@
+#include "query_stats.h"
+
+namespace {
+
+thread_local QueryStats* current_stats = nullptr;
+
+} // namespace
+
+QueryStats& QueryStats::operator+=(const QueryStats& other) {
+    query_count += other.query_count;
+    parse_time += other.parse_time;
+    resolved_terms += other.resolved_terms;
+    dropped_terms += other.dropped_terms;
+    soft_stop_terms += other.soft_stop_terms;
+    expanded_terms += other.expanded_terms;
+    fuzzy_terms += other.fuzzy_terms;
+    candidate_generation_time += other.candidate_generation_time;
+    scanned_postings += other.scanned_postings;
+    skipped_postings += other.skipped_postings;
+    predicate_calls += other.predicate_calls;
+    scored_documents += other.scored_documents;
+    excluded_documents += other.excluded_documents;
+    sort_time += other.sort_time;
+    allocations += other.allocations;
+    return *this;
+}
+
+QueryStats operator+(QueryStats lhs, const QueryStats& rhs) {
+    return lhs += rhs;
+}
+
+std::ostream& operator<<(std::ostream& out, const QueryStats& stats) {
+    out << "queries: " << stats.query_count
+        << ", parse: " << std::chrono::duration_cast<std::chrono::microseconds>(stats.parse_time).count() << " us"
+        << ", terms: " << stats.resolved_terms << " resolved, " << stats.dropped_terms << " dropped, " << stats.soft_stop_terms << " soft stop, " << stats.expanded_terms << " expanded, " << stats.fuzzy_terms << " fuzzy"
+        << ", candidate generation: " << std::chrono::duration_cast<std::chrono::microseconds>(stats.candidate_generation_time).count() << " us"
+        << ", postings: " << stats.scanned_postings << " scanned, " << stats.skipped_postings << " skipped"
+        << ", predicate calls: " << stats.predicate_calls
+        << ", documents: " << stats.scored_documents << " scored, " << stats.excluded_documents << " excluded"
+        << ", sort: " << std::chrono::duration_cast<std::chrono::microseconds>(stats.sort_time).count() << " us"
+        << ", allocations: " << stats.allocations;
+    return out;
+}
+
+void PrintJson(std::ostream& out, const QueryStats& stats) {
+    out << "{\"query_count\": " << stats.query_count
+        << ", \"parse_time_ns\": " << stats.parse_time.count()
+        << ", \"resolved_terms\": " << stats.resolved_terms
+        << ", \"dropped_terms\": " << stats.dropped_terms
+        << ", \"soft_stop_terms\": " << stats.soft_stop_terms
+        << ", \"expanded_terms\": " << stats.expanded_terms
+        << ", \"fuzzy_terms\": " << stats.fuzzy_terms
+        << ", \"candidate_generation_time_ns\": " << stats.candidate_generation_time.count()
+        << ", \"scanned_postings\": " << stats.scanned_postings
+        << ", \"skipped_postings\": " << stats.skipped_postings
+        << ", \"predicate_calls\": " << stats.predicate_calls
+        << ", \"scored_documents\": " << stats.scored_documents
+        << ", \"excluded_documents\": " << stats.excluded_documents
+        << ", \"sort_time_ns\": " << stats.sort_time.count()
+        << ", \"allocations\": " << stats.allocations << "}";
+}
+
+QueryStatsCollector::QueryStatsCollector(QueryStats& stats) noexcept
+    : previous_stats_(current_stats) {
+    current_stats = &stats;
+}
+
+QueryStatsCollector::~QueryStatsCollector() {
+    current_stats = previous_stats_;
+}
+
+QueryStats* QueryStatsCollector::GetCurrent() noexcept {
+    return current_stats;
+}
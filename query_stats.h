@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Статистика выполнения поисковых запросов
+struct QueryStats {
+    uint64_t query_count = 0;
+    std::chrono::nanoseconds parse_time{};
+    // слова запроса, найденные в индексе
+    uint64_t resolved_terms = 0;
+    // плюс-слова, которых нет в индексе
+    uint64_t dropped_terms = 0;
+    // частые плюс-слова, пропущенные при подсчёте релевантности
+    uint64_t soft_stop_terms = 0;
+    // слова словаря, подставленные вместо префиксов запроса
+    uint64_t expanded_terms = 0;
+    // слова словаря, найденные поиском с опечатками, и время поиска этих слов
+    uint64_t fuzzy_terms = 0;
+    std::chrono::nanoseconds candidate_generation_time{};
+    uint64_t scanned_postings = 0;
+    // записи, которые не понадобилось просматривать после досрочной остановки поиска
+    uint64_t skipped_postings = 0;
+    uint64_t predicate_calls = 0;
+    // документы, для которых посчитана релевантность
+    uint64_t scored_documents = 0;
+    // документы, исключённые минус-словами
+    uint64_t excluded_documents = 0;
+    // сортировка и отбор лучших документов
+    std::chrono::nanoseconds sort_time{};
+    // оценка числа выделений памяти под промежуточные словари и результаты
+    uint64_t allocations = 0;
+
+    QueryStats& operator+=(const QueryStats& other);
+};
+
+QueryStats operator+(QueryStats lhs, const QueryStats& rhs);
+
+std::ostream& operator<<(std::ostream& out, const QueryStats& stats);
+
+void PrintJson(std::ostream& out, const QueryStats& stats);
+
+/**
+ * Собирает статистику запросов, выполняемых текущим потоком, пока существует объект.
+ *
+ * Без сборщика запросы только проверяют, что он не задан. ProcessQueries собирает
+ * статистику запросов, выполненных другими потоками, в сборщик вызывающего потока.
+ *
+ * Пример использования:
+ *
+ *  QueryStats stats;
+ *  {
+ *      QueryStatsCollector collector(stats);
+ *      search_server.FindTopDocuments("curly cat"s);
+ *  }
+ *  std::cout << stats << std::endl;
+ */
+class QueryStatsCollector {
+public:
+    explicit QueryStatsCollector(QueryStats& stats) noexcept;
+
+    QueryStatsCollector(const QueryStatsCollector&) = delete;
+    QueryStatsCollector& operator=(const QueryStatsCollector&) = delete;
+
+    // Восстанавливает сборщик, действовавший до создания объекта
+    ~QueryStatsCollector();
+
+    // Статистика, в которую собираются запросы текущего потока, или nullptr
+    static QueryStats* GetCurrent() noexcept;
+
+private:
+    QueryStats* previous_stats_;
+};
@@ -1,27 +1,153 @@
 #include "remove_duplicates.h"
+#include "hash_utils.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-	std::map<std::vector<std::string_view>, int> doc_words;
-	std::vector<int> duplicate_ids;
+#include <algorithm>
+#include <execution>
+#include <functional>
+#include <iostream>
+
+DuplicateDetector::DuplicateDetector(double min_similarity, size_t band_count, size_t rows_per_band)
+	: min_similarity_(min_similarity)
+	, band_count_(std::max<size_t>(1, band_count))
+	, rows_per_band_(std::max<size_t>(1, rows_per_band))
+	, band_buckets_(IsExactOnly() ? 0 : band_count_) {
+}
+
+DuplicateDetector::Fingerprint DuplicateDetector::ComputeFingerprint(WordFrequenciesView word_freqs) const {
+	Fingerprint fingerprint;
+	if (!IsExactOnly()) {
+		fingerprint.min_hashes.assign(band_count_ * rows_per_band_, UINT64_MAX);
+	}
+
+	// Слова идут в порядке словаря сервера, а не по алфавиту, поэтому хеши слов складываются:
+	// сумма зависит только от множества слов
+	for (const auto& [word, _] : word_freqs) {
+		const uint64_t word_hash = std::hash<std::string_view>{}(word);
+		fingerprint.words_hash += MixHash(word_hash);
+		for (size_t i = 0; i < fingerprint.min_hashes.size(); ++i) {
+			fingerprint.min_hashes[i] = std::min(fingerprint.min_hashes[i], MixHash(word_hash + i));
+		}
+	}
+	return fingerprint;
+}
 
-	for (const int document_id : search_server) {
-		auto word_freqs = search_server.GetWordFrequencies(document_id);
-		std::vector<std::string_view> words(word_freqs.size());
-		std::transform(word_freqs.cbegin(), word_freqs.cend(),
-			std::inserter(words, words.begin()), [](const std::pair<std::string_view, double>& elements) {
-				return elements.first;
-			});
-
-        if (!words_of_docs_processed.count(doc_words_vector)) {
-            words_of_docs_processed.insert(doc_words_vector);
-        }
-        else {
-            doc_duplicated_ids.insert(doc_found);
-        }
-    }
+std::optional<int> DuplicateDetector::Add(int document_id, const Fingerprint& fingerprint, const SimilarityFunction& compute_similarity) {
+	const auto [first, last] = words_hash_to_document_.equal_range(fingerprint.words_hash);
+	for (auto it = first; it != last; ++it) {
+		if (compute_similarity(it->second) >= 1.0) {
+			return it->second;
+		}
+	}
+
+	if (!IsExactOnly()) {
+		std::optional<int> original_id;
+		for (size_t band = 0; band < band_count_ && !original_id; ++band) {
+			const auto it = band_buckets_[band].find(ComputeBandHash(fingerprint.min_hashes, band));
+			if (it == band_buckets_[band].end()) {
+				continue;
+			}
+			for (const int candidate_id : it->second) {
+				if (EstimateSimilarity(fingerprint.min_hashes, document_min_hashes_.at(candidate_id)) >= min_similarity_
+					&& compute_similarity(candidate_id) >= min_similarity_) {
+					original_id = candidate_id;
+					break;
+				}
+			}
+		}
+		if (original_id) {
+			return original_id;
+		}
+
+		for (size_t band = 0; band < band_count_; ++band) {
+			band_buckets_[band][ComputeBandHash(fingerprint.min_hashes, band)].push_back(document_id);
+		}
+		document_min_hashes_.emplace(document_id, fingerprint.min_hashes);
+	}
+
+	words_hash_to_document_.emplace(fingerprint.words_hash, document_id);
+	return std::nullopt;
+}
+
+bool DuplicateDetector::IsExactOnly() const {
+	return min_similarity_ >= 1.0;
+}
+
+uint64_t DuplicateDetector::ComputeBandHash(const std::vector<uint64_t>& min_hashes, size_t band) const {
+	uint64_t band_hash = band;
+	for (size_t row = band * rows_per_band_; row < (band + 1) * rows_per_band_; ++row) {
+		band_hash = MixHash(band_hash ^ min_hashes[row]);
+	}
+	return band_hash;
+}
+
+double DuplicateDetector::EstimateSimilarity(const std::vector<uint64_t>& lhs, const std::vector<uint64_t>& rhs) const {
+	size_t equal_count = 0;
+	for (size_t i = 0; i < lhs.size(); ++i) {
+		equal_count += lhs[i] == rhs[i];
+	}
+	return static_cast<double>(equal_count) / lhs.size();
+}
+
+double ComputeWordSetSimilarity(WordFrequenciesView lhs, WordFrequenciesView rhs) {
+	// Слова идут в порядке словаря своего сервера, поэтому для слияния их нужно отсортировать
+	const auto collect_sorted_words = [](WordFrequenciesView word_freqs) {
+		std::vector<std::string_view> words;
+		words.reserve(word_freqs.size());
+		for (const auto& [word, _] : word_freqs) {
+			words.push_back(word);
+		}
+		std::sort(words.begin(), words.end());
+		return words;
+	};
+	const std::vector<std::string_view> lhs_words = collect_sorted_words(lhs);
+	const std::vector<std::string_view> rhs_words = collect_sorted_words(rhs);
+
+	size_t common_count = 0;
+	for (auto lhs_it = lhs_words.begin(), rhs_it = rhs_words.begin(); lhs_it != lhs_words.end() && rhs_it != rhs_words.end();) {
+		if (*lhs_it < *rhs_it) {
+			++lhs_it;
+		}
+		else if (*rhs_it < *lhs_it) {
+			++rhs_it;
+		}
+		else {
+			++common_count;
+			++lhs_it;
+			++rhs_it;
+		}
+	}
+	const size_t union_count = lhs_words.size() + rhs_words.size() - common_count;
+	return union_count == 0 ? 1.0 : static_cast<double>(common_count) / union_count;
+}
+
+void RemoveDuplicates(SearchServer& search_server, double min_similarity, size_t band_count, size_t rows_per_band) {
+	DuplicateDetector detector(min_similarity, band_count, rows_per_band);
+
+	const std::vector<int> document_ids(search_server.begin(), search_server.end());
+	std::vector<DuplicateDetector::Fingerprint> fingerprints(document_ids.size());
+	std::transform(std::execution::par,
+		document_ids.begin(), document_ids.end(),
+		fingerprints.begin(), [&search_server, &detector](int document_id) {
+			return detector.ComputeFingerprint(search_server.GetWordFrequencies(document_id));
+		});
+
+	// Документы добавляются по возрастанию id, поэтому сохраняется документ с меньшим id
+	std::vector<int> duplicate_ids;
+	for (size_t i = 0; i < document_ids.size(); ++i) {
+		const auto compute_similarity = [&search_server, document_id = document_ids[i]](int original_id) {
+			return ComputeWordSetSimilarity(search_server.GetWordFrequencies(document_id), search_server.GetWordFrequencies(original_id));
+		};
+		if (detector.Add(document_ids[i], fingerprints[i], compute_similarity)) {
+			duplicate_ids.push_back(document_ids[i]);
+		}
+	}
 
 	for (const int document_id : duplicate_ids) {
 		std::cout << "Found duplicate document id "s << document_id << std::endl;
 		search_server.RemoveDocument(document_id);
 	}
 }
+
+void RemoveDuplicates(SearchServer& search_server) {
+	RemoveDuplicates(search_server, 1.0);
+}
@@ -2,4 +2,81 @@
 
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Потоковый поиск дубликатов по отпечаткам документов.
+ *
+ * Для каждого документа хранится только отпечаток фиксированного размера:
+ * 64-битный хеш множества слов для точных дубликатов и MinHash-подпись
+ * из band_count * rows_per_band значений для почти дубликатов.
+ * Кандидаты в почти дубликаты ищутся по LSH-корзинам: подпись делится на band_count полос,
+ * документы с совпавшей полосой сравниваются по оценке коэффициента Жаккара.
+ * Совпадение отпечатков не доказывает сходства: хеши и оценки могут ошибаться,
+ * поэтому кандидат подтверждается точным сравнением документов через compute_similarity.
+ *
+ * Пример использования:
+ *
+ *  DuplicateDetector detector(0.8);
+ *  for (const int document_id : search_server) {
+ *      const auto word_freqs = search_server.GetWordFrequencies(document_id);
+ *      const auto compute_similarity = [&](int original_id) {
+ *          return ComputeWordSetSimilarity(word_freqs, search_server.GetWordFrequencies(original_id));
+ *      };
+ *      if (const auto original_id = detector.Add(document_id, detector.ComputeFingerprint(word_freqs), compute_similarity)) {
+ *          ... // документ document_id дублирует *original_id
+ *      }
+ *  }
+ */
+class DuplicateDetector {
+public:
+    struct Fingerprint {
+        uint64_t words_hash = 0;
+        std::vector<uint64_t> min_hashes;
+    };
+
+    // Точный коэффициент Жаккара множеств слов добавляемого документа и документа original_id
+    using SimilarityFunction = std::function<double(int original_id)>;
+
+    // min_similarity — минимальный коэффициент Жаккара множеств слов, при котором документы считаются дубликатами.
+    // При min_similarity >= 1 ищутся только точные дубликаты и MinHash-подписи не вычисляются
+    explicit DuplicateDetector(double min_similarity = 1.0, size_t band_count = 16, size_t rows_per_band = 4);
+
+    Fingerprint ComputeFingerprint(WordFrequenciesView word_freqs) const;
+
+    // Возвращает id ранее добавленного документа, дубликатом которого является документ.
+    // Кандидат с подходящим отпечатком возвращается, только если compute_similarity подтверждает сходство.
+    // Дубликаты не запоминаются, поэтому память растёт только с числом уникальных документов
+    std::optional<int> Add(int document_id, const Fingerprint& fingerprint, const SimilarityFunction& compute_similarity);
+
+private:
+    const double min_similarity_;
+    const size_t band_count_;
+    const size_t rows_per_band_;
+
+    // у разных множеств слов хеши могут совпасть
+    std::unordered_multimap<uint64_t, int> words_hash_to_document_;
+    std::vector<std::unordered_map<uint64_t, std::vector<int>>> band_buckets_;
+    std::unordered_map<int, std::vector<uint64_t>> document_min_hashes_;
+
+    bool IsExactOnly() const;
+
+    uint64_t ComputeBandHash(const std::vector<uint64_t>& min_hashes, size_t band) const;
+
+    double EstimateSimilarity(const std::vector<uint64_t>& lhs, const std::vector<uint64_t>& rhs) const;
+};
+
+// Коэффициент Жаккара множеств слов двух документов; у двух пустых документов он равен 1
+double ComputeWordSetSimilarity(WordFrequenciesView lhs, WordFrequenciesView rhs);
+
+// Удаляет документы с тем же набором слов, что у документа с меньшим id
+void RemoveDuplicates(SearchServer& search_server);
+
+// Удаляет документы, похожие на документ с меньшим id с коэффициентом Жаккара не меньше min_similarity
+void RemoveDuplicates(SearchServer& search_server, double min_similarity, size_t band_count = 16, size_t rows_per_band = 4);
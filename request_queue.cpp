@@ -1,40 +1,132 @@
 #include "request_queue.h"
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Номера очередей не повторяются, поэтому поток не спутает кольцо удалённой очереди с новой
+std::atomic<uint64_t> next_queue_id = 0;
+
+size_t GetLatencyBucket(std::chrono::steady_clock::duration latency) {
+    uint64_t microseconds = static_cast<uint64_t>(std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+    size_t bucket = 0;
+    while (microseconds > 0 && bucket + 1 < LATENCY_HISTOGRAM_SIZE) {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+} // namespace
+
+RequestQueue::ThreadBuckets::ThreadBuckets(size_t bucket_count)
+    : buckets(std::make_unique<Bucket[]>(bucket_count)) {
+}
+
+RequestQueue::RequestQueue(const SearchServer& search_server, std::chrono::steady_clock::duration window, size_t bucket_count)
     : search_server_(search_server)
-    , no_results_requests_(0)
-    , current_time_(0) {
+    , id_(next_queue_id.fetch_add(1))
+    , start_time_(Clock::now())
+    , bucket_duration_(std::max<Clock::duration>(Clock::duration(1), window / std::max<size_t>(1, bucket_count)))
+    , bucket_count_(std::max<size_t>(1, bucket_count)) {
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+    const Clock::time_point start_time = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(static_cast<int>(result.size()));
+    AddRequest(result.size(), Clock::now() - start_time);
     return result;
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
+    const Clock::time_point start_time = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(static_cast<int>(result.size()));
+    AddRequest(result.size(), Clock::now() - start_time);
     return result;
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return no_results_requests_;
+    return static_cast<int>(GetStatistics().no_result_count);
 }
 
-void RequestQueue::AddRequest(int results_num) {
-    // новый запрос - новая секунда
-    ++current_time_;
-    // удаляем все результаты поиска, которые устарели
-    while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp) {
-        if (0 == requests_.front().results) {
-            --no_results_requests_;
+RequestStatistics RequestQueue::GetStatistics() const {
+    const Clock::time_point now = Clock::now();
+    const int64_t current_interval = GetInterval(now);
+
+    RequestStatistics statistics;
+    {
+        std::lock_guard guard(thread_buckets_mutex_);
+        for (const auto& [_, thread_buckets] : thread_buckets_) {
+            for (size_t i = 0; i < bucket_count_; ++i) {
+                const Bucket& bucket = thread_buckets->buckets[i];
+                // Интервал, который обнуляется прямо сейчас, может быть прочитан не целиком,
+                // для статистики это допустимо
+                const int64_t interval = bucket.interval.load(std::memory_order_acquire);
+                if (interval < 0 || current_interval - interval >= static_cast<int64_t>(bucket_count_)) {
+                    continue;
+                }
+                statistics.request_count += bucket.request_count.load(std::memory_order_relaxed);
+                for (size_t k = 0; k < bucket.result_counts.size(); ++k) {
+                    statistics.result_count_histogram[k] += bucket.result_counts[k].load(std::memory_order_relaxed);
+                }
+                for (size_t k = 0; k < bucket.latency_counts.size(); ++k) {
+                    statistics.latency_histogram[k] += bucket.latency_counts[k].load(std::memory_order_relaxed);
+                }
+            }
         }
-        requests_.pop_front();
     }
-    // сохраняем новый результат поиска
-    requests_.push_back({ current_time_, results_num });
-    if (0 == results_num) {
-        ++no_results_requests_;
+
+    statistics.no_result_count = statistics.result_count_histogram[0];
+    statistics.window = std::min(bucket_duration_ * static_cast<int64_t>(bucket_count_), now - start_time_);
+    const double seconds = std::chrono::duration<double>(statistics.window).count();
+    if (seconds > 0.0) {
+        statistics.queries_per_second = statistics.request_count / seconds;
     }
-}
\ No newline at end of file
+    if (statistics.request_count > 0) {
+        statistics.no_result_rate = static_cast<double>(statistics.no_result_count) / statistics.request_count;
+    }
+    return statistics;
+}
+
+RequestQueue::ThreadBuckets& RequestQueue::GetThreadBuckets() {
+    // Номер очереди и её кольцо для текущего потока
+    thread_local std::pair<uint64_t, ThreadBuckets*> last_thread_buckets{ UINT64_MAX, nullptr };
+    if (last_thread_buckets.first == id_) {
+        return *last_thread_buckets.second;
+    }
+
+    std::lock_guard guard(thread_buckets_mutex_);
+    std::unique_ptr<ThreadBuckets>& thread_buckets = thread_buckets_[std::this_thread::get_id()];
+    if (!thread_buckets) {
+        thread_buckets = std::make_unique<ThreadBuckets>(bucket_count_);
+    }
+    last_thread_buckets = { id_, thread_buckets.get() };
+    return *thread_buckets;
+}
+
+int64_t RequestQueue::GetInterval(Clock::time_point time) const {
+    return (time - start_time_) / bucket_duration_;
+}
+
+void RequestQueue::AddRequest(size_t result_count, Clock::duration latency) {
+    const int64_t interval = GetInterval(Clock::now());
+    Bucket& bucket = GetThreadBuckets().buckets[static_cast<size_t>(interval) % bucket_count_];
+
+    // В кольцо пишет только текущий поток, поэтому обнуление не пересекается с другими записями
+    if (bucket.interval.load(std::memory_order_relaxed) != interval) {
+        bucket.request_count.store(0, std::memory_order_relaxed);
+        for (auto& count : bucket.result_counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        for (auto& count : bucket.latency_counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        bucket.interval.store(interval, std::memory_order_release);
+    }
+
+    bucket.request_count.fetch_add(1, std::memory_order_relaxed);
+    bucket.result_counts[std::min<size_t>(result_count, MAX_RESULT_DOCUMENT_COUNT)].fetch_add(1, std::memory_order_relaxed);
+    bucket.latency_counts[GetLatencyBucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
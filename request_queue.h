@@ -3,37 +3,107 @@
 #include "search_server.h"
 #include "document.h"
 
-#include <deque>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+const size_t LATENCY_HISTOGRAM_SIZE = 32;
+
+// Статистика запросов за скользящее окно
+struct RequestStatistics {
+    // длительность окна, а пока очередь существует меньше окна — время её существования
+    std::chrono::steady_clock::duration window{};
+    uint64_t request_count = 0;
+    uint64_t no_result_count = 0;
+    double queries_per_second = 0.0;
+    double no_result_rate = 0.0;
+    // result_count_histogram[k] — число запросов, вернувших k документов
+    std::array<uint64_t, MAX_RESULT_DOCUMENT_COUNT + 1> result_count_histogram{};
+    // latency_histogram[0] — запросы короче 1 мкс, latency_histogram[k] — от 2^(k-1) до 2^k мкс,
+    // последний элемент учитывает и все более долгие запросы
+    std::array<uint64_t, LATENCY_HISTOGRAM_SIZE> latency_histogram{};
+};
+
+/**
+ * Выполняет запросы к поисковому серверу и собирает их статистику за скользящее окно времени.
+ *
+ * Запросы можно выполнять одновременно из нескольких потоков. Каждый поток пишет
+ * в своё кольцо временных интервалов без блокировок, при чтении статистики кольца
+ * складываются. Окно делится на bucket_count интервалов и сдвигается по интервалу.
+ *
+ * Пример использования:
+ *
+ *  RequestQueue request_queue(search_server);
+ *  request_queue.AddFindRequest("curly cat"s);
+ *  const RequestStatistics statistics = request_queue.GetStatistics();
+ */
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    explicit RequestQueue(const SearchServer& search_server,
+        std::chrono::steady_clock::duration window = std::chrono::minutes(1), size_t bucket_count = 60);
+
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
+    // Число запросов без результатов за окно
     int GetNoResultRequests() const;
 
+    RequestStatistics GetStatistics() const;
+
 private:
-    struct QueryResult {
-        uint64_t timestamp;
-        int results;
+    using Clock = std::chrono::steady_clock;
+
+    // Статистика одного интервала окна. Интервал помечается номером,
+    // и при переходе к новому номеру счётчики обнуляются
+    struct Bucket {
+        std::atomic<int64_t> interval = -1;
+        std::atomic<uint64_t> request_count = 0;
+        std::array<std::atomic<uint64_t>, MAX_RESULT_DOCUMENT_COUNT + 1> result_counts{};
+        std::array<std::atomic<uint64_t>, LATENCY_HISTOGRAM_SIZE> latency_counts{};
+    };
+
+    // Кольцо интервалов одного потока: в него пишет только этот поток
+    struct ThreadBuckets {
+        explicit ThreadBuckets(size_t bucket_count);
+
+        std::unique_ptr<Bucket[]> buckets;
     };
 
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
     const SearchServer& search_server_;
-    int no_results_requests_;
-    uint64_t current_time_;
+    const uint64_t id_;
+    const Clock::time_point start_time_;
+    const Clock::duration bucket_duration_;
+    const size_t bucket_count_;
+
+    // Мьютекс защищает только список колец: поток регистрирует кольцо при первом запросе.
+    // Кольца принадлежат очереди и освобождаются вместе с ней
+    mutable std::mutex thread_buckets_mutex_;
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadBuckets>> thread_buckets_;
+
+    // Кольцо текущего потока. Поток помнит кольцо последней очереди, в которую писал,
+    // и ищет его в списке очереди, только когда переходит к другой очереди
+    ThreadBuckets& GetThreadBuckets();
+
+    int64_t GetInterval(Clock::time_point time) const;
 
-    void AddRequest(int results_num);
+    void AddRequest(size_t result_count, Clock::duration latency);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const Clock::time_point start_time = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddRequest(result.size());
+    AddRequest(result.size(), Clock::now() - start_time);
     return result;
-}
\ No newline at end of file
+}
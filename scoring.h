@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Модель релевантности документа запросу
+enum class ScoringModel {
+    // частота слова в документе, умноженная на IDF
+    TF_IDF,
+    // Okapi BM25: вклад слова растёт медленнее числа его вхождений и нормируется по длине документа
+    BM25
+};
+
+// Статистика корпуса, от которой зависят веса слов
+struct ScoringCorpus {
+    double document_count = 0.0;
+    // среднее число слов документа без стоп-слов
+    double average_word_count = 0.0;
+};
+
+/**
+ * Модели релевантности. Модель создаётся на запрос по статистике корпуса и задаёт:
+ *  ComputeDocumentNorm — нормировку документа по длине, её вычисляют при добавлении документа;
+ *  ComputeInverseDocumentFreq — IDF слова по числу содержащих его документов;
+ *  ComputeTermWeight — вес слова в документе по числу вхождений и нормировке документа.
+ * Релевантность — сумма весов плюс-слов, умноженных на их IDF.
+ *
+ * Циклы подсчёта релевантности компилируются отдельно для каждой модели,
+ * поэтому вес записи считается без виртуальных вызовов и ветвлений по модели.
+ */
+class TfIdfScoring {
+public:
+    explicit TfIdfScoring(const ScoringCorpus& corpus) noexcept
+        : document_count_(corpus.document_count)
+    {
+    }
+
+    // Обратная длина: частота слова получается умножением, а не делением
+    static double ComputeDocumentNorm(uint32_t word_count) noexcept {
+        return word_count > 0 ? 1.0 / word_count : 0.0;
+    }
+
+    double ComputeInverseDocumentFreq(double document_freq) const noexcept {
+        return std::log(document_count_ / document_freq);
+    }
+
+    double ComputeTermWeight(uint32_t count, double document_norm) const noexcept {
+        return count * document_norm;
+    }
+
+private:
+    double document_count_;
+};
+
+class Bm25Scoring {
+public:
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    // Нормировка k1 * (1 - b + b * |D| / avgdl) зависит от средней длины документа, которая меняется
+    // с корпусом. Поэтому при добавлении запоминается длина |D|, а множители вычисляются на запрос
+    explicit Bm25Scoring(const ScoringCorpus& corpus) noexcept
+        : document_count_(corpus.document_count)
+        , length_base_(K1 * (1.0 - B))
+        , length_factor_(corpus.average_word_count > 0.0 ? K1 * B / corpus.average_word_count : 0.0)
+    {
+    }
+
+    static double ComputeDocumentNorm(uint32_t word_count) noexcept {
+        return word_count;
+    }
+
+    // Вариант IDF, который не бывает отрицательным для слов, встречающихся в большинстве документов
+    double ComputeInverseDocumentFreq(double document_freq) const noexcept {
+        return std::log(1.0 + (document_count_ - document_freq + 0.5) / (document_freq + 0.5));
+    }
+
+    double ComputeTermWeight(uint32_t count, double document_norm) const noexcept {
+        return count * (K1 + 1.0) / (count + length_base_ + length_factor_ * document_norm);
+    }
+
+private:
+    double document_count_;
+    double length_base_;
+    double length_factor_;
+};
+
+// Вызывает function с моделью model. Модель выбирается одним ветвлением на вызов
+template <typename Function>
+decltype(auto) VisitScoringModel(ScoringModel model, const ScoringCorpus& corpus, Function&& function) {
+    if (model == ScoringModel::BM25) {
+        return function(Bm25Scoring(corpus));
+    }
+    return function(TfIdfScoring(corpus));
+}
+
+// Добавляет к scores[i] вес слова в i-м документе, умноженный на IDF. Массивы плоские,
+// а цикл без ветвлений, поэтому компилятор векторизует его (GCC — начиная с -O3)
+template <typename Scoring>
+void AccumulateTermScores(const Scoring& scoring, double inverse_document_freq,
+    const uint32_t* counts, const double* document_norms, size_t size, double* scores) {
+    for (size_t i = 0; i < size; ++i) {
+        scores[i] += scoring.ComputeTermWeight(counts[i], document_norms[i]) * inverse_document_freq;
+    }
+}
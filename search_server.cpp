@@ -1,6 +1,57 @@
 #include "search_server.h"
 
+// Частота слова в документе из word_count слов, где оно встречается count раз
+static double ComputeTermFreq(uint32_t count, uint32_t word_count) {
+    return static_cast<double>(count) / word_count;
+}
+
+static bool IsLessTermId(const DocumentTerm& lhs, const DocumentTerm& rhs) {
+    return lhs.term_id < rhs.term_id;
+}
+
+// Квантованный вклад записи — число единиц impact_unit с округлением вверх, не меньше единицы:
+// запись без вклада не отличалась бы от отсутствующей
+static uint16_t QuantizeImpact(double impact, double impact_unit) {
+    constexpr double MAX_QUANTIZED_IMPACT = std::numeric_limits<uint16_t>::max();
+    return static_cast<uint16_t>(std::clamp(std::ceil(impact / impact_unit), 1.0, MAX_QUANTIZED_IMPACT));
+}
+
+// Двоичный поиск номера слова среди слов документа, упорядоченных по номерам
+static bool ContainsTerm(const DocumentTerm* first, const DocumentTerm* last, uint32_t term_id) {
+    const DocumentTerm* const it = std::lower_bound(first, last, DocumentTerm{ term_id, 0 }, IsLessTermId);
+    return it != last && it->term_id == term_id;
+}
+
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    PreparedDocument prepared = PrepareDocument(document_id, document, status, ratings);
+    CheckMemoryBudget();
+    impact_index_.reset();
+
+    const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::document_terms);
+    const auto terms = std::allocate_shared<DocumentTermBlock>(allocator, prepared.word_counts.size(), allocator);
+    for (size_t i = 0; i < prepared.word_counts.size(); ++i) {
+        const auto [word, count] = prepared.word_counts[i];
+        const uint32_t term_id = AcquireTermId(word);
+        GetMutablePostings(terms_.GetMutable(term_id).postings).emplace(document_id, count);
+        (*terms)[i] = { term_id, count };
+    }
+    std::sort(terms->begin(), terms->end(), IsLessTermId);
+
+    documents_.emplace(document_id, DocumentData{ prepared.rating, prepared.status,
+        std::shared_ptr<const DocumentTerm>(terms, terms->data()), static_cast<uint32_t>(terms->size()), prepared.word_count,
+        ComputeDocumentNorm(prepared.word_count) });
+    total_word_count_ += prepared.word_count;
+}
+
+PreparedDocument SearchServer::PrepareDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) const {
+    const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::texts);
+    auto text = std::allocate_shared<CountedString>(allocator, document, allocator);
+    const std::string_view text_view = *text;
+    return PrepareDocument(document_id, text_view, status, ratings, std::move(text));
+}
+
+PreparedDocument SearchServer::PrepareDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings,
+    std::shared_ptr<const void> text_owner) const {
     if (document_id < 0) {
         throw std::invalid_argument("документ с отрицательным id"s);
     }
@@ -11,18 +62,92 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
         throw std::invalid_argument("наличие недопустимых символов"s);
     }
 
-    auto words = SplitIntoWordsNoStop(document);
-    const std::string document_string{ document };
-    documents_.emplace(document_id, DocumentData{ SearchServer::ComputeAverageRating(ratings), status, document_string });
-    
-    words = SplitIntoWordsNoStop(documents_.at(document_id).text_);
-    
-    for (auto word : words) {
-        word_to_document_freqs_[word][document_id] += 1.0 / words.size();
-        document_to_word_freqs_[document_id][word] += 1.0 / words.size();
+    PreparedDocument prepared;
+    prepared.id = document_id;
+    prepared.rating = ComputeAverageRating(ratings);
+    prepared.status = status;
+    prepared.text = std::move(text_owner);
+
+    std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    std::sort(words.begin(), words.end());
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (i > 0 && words[i] == words[i - 1]) {
+            ++prepared.word_counts.back().second;
+        }
+        else {
+            prepared.word_counts.emplace_back(words[i], 1);
+        }
+    }
+    prepared.word_count = static_cast<uint32_t>(words.size());
+
+    return prepared;
+}
+
+void SearchServer::AddDocuments(std::vector<PreparedDocument> documents) {
+    AddDocuments(std::execution::seq, std::move(documents));
+}
+
+SearchServer::Addition SearchServer::PrepareAddition(std::vector<PreparedDocument>& documents) {
+    CheckMemoryBudget();
+    std::sort(documents.begin(), documents.end(),
+        [](const PreparedDocument& lhs, const PreparedDocument& rhs) {
+            return lhs.id < rhs.id;
+    });
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (documents_.count(documents[i].id) || (i > 0 && documents[i - 1].id == documents[i].id)) {
+            throw std::invalid_argument("документ c id ранее добавленного документа"s);
+        }
+    }
+    impact_index_.reset();
+
+    struct WordDocuments {
+        uint32_t term_id = 0;
+        std::vector<std::pair<int, uint32_t>> document_counts;
+    };
+
+    // Ключи — слова из текстов добавляемых документов. Для каждого слова каждого документа
+    // запоминается его запись, чтобы после заполнения словаря взять из неё номер слова
+    std::map<std::string_view, WordDocuments> word_documents;
+    std::vector<const WordDocuments*> document_words;
+    for (const PreparedDocument& document : documents) {
+        for (const auto& [word, count] : document.word_counts) {
+            WordDocuments& entry = word_documents[word];
+            entry.document_counts.emplace_back(document.id, count);
+            document_words.push_back(&entry);
+        }
+    }
+
+    // Словарь и общие списки документов меняются последовательно, сами списки дополняются параллельно
+    Addition addition;
+    addition.words.reserve(word_documents.size());
+    for (auto& [word, entry] : word_documents) {
+        entry.term_id = AcquireTermId(word);
+        addition.words.push_back({ &GetMutablePostings(terms_.GetMutable(entry.term_id).postings), std::move(entry.document_counts) });
+    }
+
+    // Слова всех документов пакета лежат в одном блоке
+    const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::document_terms);
+    const auto terms = std::allocate_shared<DocumentTermBlock>(allocator, document_words.size(), allocator);
+    addition.documents.reserve(documents.size());
+    size_t position = 0;
+    for (const PreparedDocument& document : documents) {
+        DocumentTerm* const first = terms->data() + position;
+        for (const auto& [word, count] : document.word_counts) {
+            (*terms)[position] = { document_words[position]->term_id, count };
+            ++position;
+        }
+        std::sort(first, terms->data() + position, IsLessTermId);
+        addition.documents.push_back({ document.rating, document.status, std::shared_ptr<const DocumentTerm>(terms, first),
+            static_cast<uint32_t>(document.word_counts.size()), document.word_count, ComputeDocumentNorm(document.word_count) });
+    }
+    return addition;
+}
+
+void SearchServer::FinishAddition(const std::vector<PreparedDocument>& documents, std::vector<DocumentData>& document_data) {
+    for (size_t i = 0; i < documents.size(); ++i) {
+        documents_.emplace(documents[i].id, std::move(document_data[i]));
+        total_word_count_ += documents[i].word_count;
     }
-    
-    document_ids_.emplace(document_id);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
@@ -33,41 +158,186 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query)
     return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+BudgetedSearchResult SearchServer::FindTopDocuments(std::string_view raw_query, const SearchBudget& budget, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, budget,
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+    });
+}
+
+BudgetedSearchResult SearchServer::FindTopDocuments(std::string_view raw_query, const SearchBudget& budget) const {
+    return FindTopDocuments(raw_query, budget, DocumentStatus::ACTUAL);
+}
+
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, page_size, cursor,
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+    });
+}
+
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor) const {
+    return FindTopDocuments(raw_query, page_size, cursor, DocumentStatus::ACTUAL);
+}
+
+QueryExplanation SearchServer::ExplainQuery(std::string_view raw_query) const {
+    const QueryPlan plan = PlanQuery(ParseQuery(raw_query));
+
+    QueryExplanation explanation;
+    explanation.strategy = plan.strategy;
+    explanation.estimated_postings = plan.estimated_postings;
+
+    for (const QueryTerm& term : plan.plus_terms) {
+        explanation.terms.push_back({ term.word, false, false, term.postings->size(), term.inverse_document_freq, false, term.edit_distance });
+    }
+    for (const QueryTerm& term : plan.minus_terms) {
+        explanation.terms.push_back({ term.word, true, false, term.postings->size(), term.inverse_document_freq });
+    }
+    for (const QueryTerm& term : plan.soft_stop_terms) {
+        explanation.terms.push_back({ term.word, false, false, term.postings->size(), term.inverse_document_freq, true, term.edit_distance });
+    }
+    for (const std::string_view word : plan.dropped_words) {
+        const Postings* const postings = FindPostings(word);
+        if (postings == nullptr) {
+            explanation.terms.push_back({ word, false, true, 0, 0.0 });
+        }
+        else {
+            explanation.terms.push_back({ word, false, true, postings->size(), ComputeInverseDocumentFreq(plan.corpus, GetWordDocumentFreq(word)) });
+        }
+    }
+
+    QueryStats stats;
+    std::vector<Document> matched_documents;
+    ExecuteQueryPlan(plan,
+        [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL;
+        },
+        matched_documents, stats);
+    explanation.actual_postings = stats.scanned_postings;
+
+    return explanation;
+}
+
+ScoringModel SearchServer::GetScoringModel() const noexcept {
+    return scoring_model_;
+}
+
 int SearchServer::GetDocumentCount() const {
     return static_cast<int>(documents_.size());
 }
 
-const std::set<int>::const_iterator SearchServer::begin() const noexcept {
-    return document_ids_.begin();
+void SearchServer::SetCorpusStatistics(const CorpusStatistics* statistics) noexcept {
+    corpus_statistics_ = statistics;
 }
 
-const std::set<int>::const_iterator SearchServer::end() const noexcept {
-    return document_ids_.end();
+void SearchServer::SetRankingMode(RankingMode mode) {
+    ranking_mode_ = mode;
+    if (mode == RankingMode::EXHAUSTIVE) {
+        impact_index_.reset();
+    }
+    else {
+        RefreshImpacts();
+    }
+}
+
+RankingMode SearchServer::GetRankingMode() const noexcept {
+    return ranking_mode_;
+}
+
+void SearchServer::RefreshImpacts() {
+    if (ranking_mode_ == RankingMode::IMPACT_ORDERED && !impact_index_) {
+        BuildImpactIndex();
+    }
+}
+
+void SearchServer::SetSoftStopWordRatio(std::optional<double> ratio) {
+    if (ratio && !(*ratio > 0.0 && *ratio <= 1.0)) {
+        throw std::invalid_argument("доля документов мягкого стоп-слова вне (0, 1]"s);
+    }
+    soft_stop_word_ratio_ = ratio;
+}
+
+std::optional<double> SearchServer::GetSoftStopWordRatio() const noexcept {
+    return soft_stop_word_ratio_;
+}
+
+std::vector<std::pair<std::string_view, double>> SearchServer::GetSoftStopWords() const {
+    std::vector<std::pair<std::string_view, double>> words;
+    if (!soft_stop_word_ratio_) {
+        return words;
+    }
+    const ScoringCorpus corpus = GetScoringCorpus();
+    for (const auto& [word, term_id] : word_to_term_id_) {
+        const double document_freq = GetWordDocumentFreq(word);
+        if (IsSoftStopWord(corpus, document_freq)) {
+            words.emplace_back(word, document_freq / corpus.document_count);
+        }
+    }
+    return words;
+}
+
+void SearchServer::SetMaxPrefixExpansions(size_t max_count) noexcept {
+    max_prefix_expansions_ = max_count;
+}
+
+size_t SearchServer::GetMaxPrefixExpansions() const noexcept {
+    return max_prefix_expansions_;
+}
+
+void SearchServer::SetFuzzySearch(std::optional<FuzzySearchOptions> options) {
+    if (!options) {
+        fuzzy_search_.reset();
+        fuzzy_index_.reset();
+        return;
+    }
+    if (options->max_edit_distance < 1 || options->max_edit_distance > 2) {
+        throw std::invalid_argument("расстояние поиска с опечатками должно быть 1 или 2"s);
+    }
+    if (!(options->distance_weight > 0.0 && options->distance_weight <= 1.0)) {
+        throw std::invalid_argument("вес слов, найденных с опечатками, должен лежать в (0, 1]"s);
+    }
+
+    if (!fuzzy_index_ || fuzzy_index_->GetMaxDistance() != options->max_edit_distance) {
+        const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::fuzzy_index);
+        auto index = std::allocate_shared<FuzzyTermIndex>(allocator, options->max_edit_distance, allocator);
+        for (const auto& [word, term_id] : word_to_term_id_) {
+            index->AddTerm(term_id, word);
+        }
+        fuzzy_index_ = std::move(index);
+    }
+    fuzzy_search_ = options;
+}
+
+const std::optional<FuzzySearchOptions>& SearchServer::GetFuzzySearch() const noexcept {
+    return fuzzy_search_;
+}
+
+SearchServer::DocumentIdIterator SearchServer::begin() const noexcept {
+    return documents_.key_begin();
+}
+
+SearchServer::DocumentIdIterator SearchServer::end() const noexcept {
+    return documents_.key_end();
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
     const Query query = ParseQuery(raw_query);
+    const DocumentData& document = documents_.at(document_id);
 
-    std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.clear();
-            return { {}, documents_.at(document_id).status };
+        if (HasWord(document, word)) {
+            return { std::vector<std::string_view>{}, document.status };
         }
     }
+
+    std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
+        if (HasWord(document, word)) {
             matched_words.push_back(word);
         }
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document.status };
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, int document_id) const {
@@ -80,14 +350,14 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
         }
 
     const Query& query = ParseQueryParallel(raw_query);
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
+    const DocumentData& document = documents_.at(document_id);
     
     if (std::any_of(query.minus_words.begin(),
                     query.minus_words.end(),
-                    [&word_freqs](const std::string_view word) {
-                        return word_freqs.count(word) > 0;
+                    [this, &document](const std::string_view word) {
+                        return HasWord(document, word);
                     })) {
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, document.status };
     }
 
     std::vector<std::string_view> matched_words;
@@ -95,39 +365,359 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     std::copy_if(query.plus_words.begin(),
                  query.plus_words.end(),
                  std::back_inserter(matched_words),
-                 [&word_freqs](const std::string_view word) {
-                     return word_freqs.count(word) > 0;
+                 [this, &document](const std::string_view word) {
+                     return HasWord(document, word);
                  });
 
     std::sort(policy, matched_words.begin(), matched_words.end());
     auto it = std::unique(matched_words.begin(), matched_words.end());
     matched_words.erase(it, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document.status };
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map<std::string_view, double> dummy;
-    if (document_to_word_freqs_.count(document_id) == 0) {
-        return dummy;
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(ThreadPool& pool, std::string_view raw_query, int document_id) const {
+    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+        throw std::invalid_argument("document_id out of range"s);
     }
-    else {
-        return document_to_word_freqs_.at(document_id);
+
+    const Query query = ParseQuery(raw_query);
+    const DocumentData& document = documents_.at(document_id);
+
+    std::atomic<bool> has_minus_word = false;
+    pool.ParallelFor(query.minus_words.size(),
+        [this, &query, &document, &has_minus_word](size_t index) {
+            if (HasWord(document, query.minus_words[index])) {
+                has_minus_word = true;
+            }
+    });
+    if (has_minus_word) {
+        return { std::vector<std::string_view>{}, document.status };
     }
+
+    std::vector<char> is_matched(query.plus_words.size(), false);
+    pool.ParallelFor(query.plus_words.size(),
+        [this, &query, &document, &is_matched](size_t index) {
+            is_matched[index] = HasWord(document, query.plus_words[index]);
+    });
+
+    std::vector<std::string_view> matched_words;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (is_matched[i]) {
+            matched_words.push_back(query.plus_words[i]);
+        }
+    }
+
+    return { matched_words, document.status };
+}
+
+WordFrequenciesView SearchServer::GetWordFrequencies(int document_id) const {
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return {};
+    }
+    const DocumentData& document = it->second;
+    return WordFrequenciesView(this, document.terms.get(), document.term_count, document.word_count);
+}
+
+WordFrequenciesView::Iterator::value_type WordFrequenciesView::Iterator::operator*() const {
+    return { search_server_->terms_[term_->term_id].word, ComputeTermFreq(term_->count, word_count_) };
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (document_to_word_freqs_.count(document_id)) {
-        std::map<std::string_view, double> search_element = document_to_word_freqs_[document_id];
+    if (documents_.count(document_id)) {
+        for (Postings* postings : DetachDocumentWords(document_id)) {
+            postings->erase(document_id);
+        }
+
+        EraseDocument(document_id);
+    }
+}
+
+void SearchServer::RemoveDocument(ThreadPool& pool, int document_id) {
+    if (documents_.count(document_id)) {
+        const std::vector<Postings*> postings = DetachDocumentWords(document_id);
+
+        // Списки документов разных слов независимы, их можно чистить параллельно
+        pool.ParallelFor(postings.size(),
+            [&postings, document_id](size_t index) {
+                postings[index]->erase(document_id);
+        });
+
+        EraseDocument(document_id);
+    }
+}
+
+std::vector<SearchServer::Postings*> SearchServer::DetachDocumentWords(int document_id) {
+    const DocumentData& document = documents_.at(document_id);
+    impact_index_.reset();
+    std::vector<Postings*> postings;
+    postings.reserve(document.term_count);
 
-        for (auto [key_string, value_double] : search_element) {
-            word_to_document_freqs_[key_string].erase(document_id);
+    for (const DocumentTerm* term = document.terms.get(); term != document.terms.get() + document.term_count; ++term) {
+        if (terms_[term->term_id].postings->size() == 1) {
+            ReleaseTerm(term->term_id);
+            continue;
         }
+        postings.push_back(&GetMutablePostings(terms_.GetMutable(term->term_id).postings));
+    }
+    return postings;
+}
+
+const SearchServer::Postings* SearchServer::FindPostings(std::string_view word) const {
+    const auto it = word_to_term_id_.find(word);
+    if (it == word_to_term_id_.end()) {
+        return nullptr;
+    }
+    return terms_[it->second].postings.get();
+}
 
-        document_to_word_freqs_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+uint32_t SearchServer::AcquireTermId(std::string_view word) {
+    const auto it = word_to_term_id_.find(word);
+    if (it != word_to_term_id_.end()) {
+        return it->second;
+    }
+
+    const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::word_to_document_freqs);
+    uint32_t term_id = 0;
+    if (free_term_ids_.empty()) {
+        term_id = static_cast<uint32_t>(terms_.size());
+        terms_.push_back({ CountedString(word, allocator), nullptr });
+    }
+    else {
+        term_id = free_term_ids_.back();
+        free_term_ids_.pop_back();
+        terms_.GetMutable(term_id).word.assign(word.data(), word.size());
+    }
+    word_to_term_id_.emplace(CountedString(word, allocator), term_id);
+    if (fuzzy_index_) {
+        GetMutableFuzzyIndex().AddTerm(term_id, word);
+    }
+    return term_id;
+}
+
+void SearchServer::ReleaseTerm(uint32_t term_id) {
+    Term& term = terms_.GetMutable(term_id);
+    if (fuzzy_index_) {
+        GetMutableFuzzyIndex().RemoveTerm(term_id, term.word);
+    }
+    word_to_term_id_.erase(term.word);
+    term.word.clear();
+    term.word.shrink_to_fit();
+    term.postings.reset();
+    free_term_ids_.push_back(term_id);
+
+    // Без документов таблица терминов не нужна, её память возвращается целиком
+    if (word_to_term_id_.empty()) {
+        terms_.clear();
+        decltype(free_term_ids_)(free_term_ids_.get_allocator()).swap(free_term_ids_);
+    }
+}
+
+bool SearchServer::HasWord(const DocumentData& document, std::string_view word) const {
+    const auto it = word_to_term_id_.find(word);
+    return it != word_to_term_id_.end()
+        && ContainsTerm(document.terms.get(), document.terms.get() + document.term_count, it->second);
+}
+
+FuzzyTermIndex& SearchServer::GetMutableFuzzyIndex() {
+    if (fuzzy_index_.use_count() > 1) {
+        const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::fuzzy_index);
+        fuzzy_index_ = std::allocate_shared<FuzzyTermIndex>(allocator, *fuzzy_index_);
+    }
+    return *fuzzy_index_;
+}
+
+std::vector<std::pair<int, uint32_t>> SearchServer::FindFuzzyTerms(std::string_view word) const {
+    std::vector<uint32_t> candidates;
+    fuzzy_index_->FindCandidates(word, candidates);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Общая строка удалений допускает расстояние до удвоенного, поэтому расстояние проверяется.
+    // Из равноудалённых слов берутся слова с большим числом документов сервера: оно известно
+    // без поиска в словаре и общей статистике
+    const int max_distance = fuzzy_search_->max_edit_distance;
+    std::vector<std::tuple<int, size_t, std::string_view, uint32_t>> terms;
+    for (const uint32_t term_id : candidates) {
+        const Term& term = terms_[term_id];
+        const int distance = ComputeEditDistance(word, term.word, max_distance);
+        if (distance <= max_distance) {
+            terms.emplace_back(distance, std::numeric_limits<size_t>::max() - term.postings->size(), term.word, term_id);
+        }
+    }
+    const size_t result_size = std::min(terms.size(), fuzzy_search_->max_expansions);
+    std::partial_sort(terms.begin(), terms.begin() + result_size, terms.end());
+
+    std::vector<std::pair<int, uint32_t>> result;
+    result.reserve(result_size);
+    for (size_t i = 0; i < result_size; ++i) {
+        result.emplace_back(std::get<0>(terms[i]), std::get<3>(terms[i]));
+    }
+    return result;
+}
+
+SearchServer::Postings& SearchServer::GetMutablePostings(std::shared_ptr<Postings>& postings) {
+    if (!postings) {
+        const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::word_to_document_freqs);
+        postings = std::allocate_shared<Postings>(allocator, allocator);
+    }
+    else if (postings.use_count() > 1) {
+        const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::word_to_document_freqs);
+        postings = std::allocate_shared<Postings>(allocator, *postings);
+    }
+    return *postings;
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    RemoveDocuments(std::execution::seq, document_ids);
+}
+
+std::vector<SearchServer::WordRemoval> SearchServer::PrepareRemoval(std::vector<int>& document_ids) {
+    std::sort(document_ids.begin(), document_ids.end());
+    document_ids.erase(std::unique(document_ids.begin(), document_ids.end()), document_ids.end());
+    document_ids.erase(std::remove_if(document_ids.begin(), document_ids.end(),
+        [this](int document_id) {
+            return documents_.count(document_id) == 0;
+        }), document_ids.end());
+    if (!document_ids.empty()) {
+        impact_index_.reset();
+    }
+
+    std::map<uint32_t, WordRemoval> word_removals;
+    for (const int document_id : document_ids) {
+        const DocumentData& document = documents_.at(document_id);
+        for (const DocumentTerm* term = document.terms.get(); term != document.terms.get() + document.term_count; ++term) {
+            auto [it, inserted] = word_removals.try_emplace(term->term_id);
+            WordRemoval& removal = it->second;
+            if (inserted) {
+                removal.term_id = term->term_id;
+            }
+            removal.document_ids.push_back(document_id);
+        }
+    }
+
+    std::vector<WordRemoval> removals;
+    removals.reserve(word_removals.size());
+    for (auto& [term_id, removal] : word_removals) {
+        removal.is_word_released = terms_[term_id].postings->size() == removal.document_ids.size();
+        if (!removal.is_word_released) {
+            // Копирование общих списков выполняется здесь, чтобы параллельная часть удаления их только меняла
+            removal.postings = &GetMutablePostings(terms_.GetMutable(term_id).postings);
+        }
+        removals.push_back(std::move(removal));
     }
+    return removals;
+}
+
+void SearchServer::RemoveFromPostings(Postings& postings, const std::vector<int>& document_ids) {
+    // Если удаляется заметная часть списка, дешевле собрать его заново за один проход
+    if (document_ids.size() * std::log2(postings.size() + 1.0) < postings.size()) {
+        for (const int document_id : document_ids) {
+            postings.erase(document_id);
+        }
+        return;
+    }
+
+    Postings remaining_postings(postings.get_allocator());
+    auto removed_it = document_ids.begin();
+    for (const auto& [document_id, count] : postings) {
+        while (removed_it != document_ids.end() && *removed_it < document_id) {
+            ++removed_it;
+        }
+        if (removed_it == document_ids.end() || *removed_it != document_id) {
+            remaining_postings.emplace(document_id, count);
+        }
+    }
+    postings = std::move(remaining_postings);
+}
+
+void SearchServer::FinishRemoval(const std::vector<int>& document_ids, const std::vector<WordRemoval>& removals) {
+    for (const WordRemoval& removal : removals) {
+        if (removal.is_word_released) {
+            ReleaseTerm(removal.term_id);
+        }
+    }
+
+    for (const int document_id : document_ids) {
+        EraseDocument(document_id);
+    }
+}
+
+void SearchServer::EraseDocument(int document_id) {
+    total_word_count_ -= documents_.at(document_id).word_count;
+    documents_.erase(document_id);
+}
+
+CountingAllocator<char> SearchServer::CountAllocationsIn(MemoryCounter MemoryCounters::* counter) const {
+    // счётчик живёт, пока жив хотя бы один аллокатор, даже если сервер уже удалён
+    return CountingAllocator<char>(std::shared_ptr<MemoryCounter>(memory_counters_, &((*memory_counters_).*counter)));
+}
+
+SearchServer::StopWordSet SearchServer::MakeStopWords(const std::set<std::string, std::less<>>& stop_words) const {
+    const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::stop_words);
+    StopWordSet result(allocator);
+    for (const std::string& word : stop_words) {
+        result.emplace_hint(result.end(), word, allocator);
+    }
+    return result;
+}
+
+void SearchServer::CheckMemoryBudget() const {
+    if (IsMemoryBudgetExceeded()) {
+        throw MemoryBudgetExceeded("память индекса превышает заданный предел"s);
+    }
+}
+
+size_t IndexMemoryStatistics::GetTotalBytes() const {
+    return stop_words_bytes + documents_bytes + word_to_document_freqs_bytes + document_terms_bytes
+        + text_bytes + impact_bytes + fuzzy_index_bytes;
+}
+
+double IndexMemoryStatistics::GetAveragePostingLength() const {
+    if (vocabulary_size == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(posting_count) / vocabulary_size;
+}
+
+IndexMemoryStatistics SearchServer::GetMemoryStatistics() const {
+    IndexMemoryStatistics statistics;
+    statistics.stop_words_bytes = memory_counters_->stop_words.load(std::memory_order_relaxed);
+    statistics.documents_bytes = memory_counters_->documents.load(std::memory_order_relaxed);
+    statistics.word_to_document_freqs_bytes = memory_counters_->word_to_document_freqs.load(std::memory_order_relaxed);
+    statistics.document_terms_bytes = memory_counters_->document_terms.load(std::memory_order_relaxed);
+    statistics.text_bytes = memory_counters_->texts.load(std::memory_order_relaxed);
+    statistics.impact_bytes = memory_counters_->impacts.load(std::memory_order_relaxed);
+    statistics.fuzzy_index_bytes = memory_counters_->fuzzy_index.load(std::memory_order_relaxed);
+
+    statistics.document_count = documents_.size();
+    statistics.vocabulary_size = word_to_term_id_.size();
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (terms_[term_id].postings) {
+            statistics.posting_count += terms_[term_id].postings->size();
+        }
+    }
+    return statistics;
+}
+
+void SearchServer::SetMemoryBudget(std::optional<size_t> max_bytes) noexcept {
+    memory_budget_ = max_bytes;
+}
+
+bool SearchServer::IsMemoryBudgetExceeded() const noexcept {
+    if (!memory_budget_) {
+        return false;
+    }
+    const MemoryCounters& counters = *memory_counters_;
+    const size_t total_bytes = counters.stop_words.load(std::memory_order_relaxed)
+        + counters.documents.load(std::memory_order_relaxed)
+        + counters.word_to_document_freqs.load(std::memory_order_relaxed)
+        + counters.document_terms.load(std::memory_order_relaxed)
+        + counters.texts.load(std::memory_order_relaxed)
+        + counters.impacts.load(std::memory_order_relaxed)
+        + counters.fuzzy_index.load(std::memory_order_relaxed);
+    return total_bytes > *memory_budget_;
 }
 
 bool SearchServer::IsStopWord(std::string_view word) const {
@@ -154,6 +744,97 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_vie
     return words;
 }
 
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        return lhs.rating > rhs.rating;
+    }
+    else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+SearchPage SearchServer::SelectPage(std::vector<Document> documents, size_t page_size, const std::optional<SearchCursor>& cursor) {
+    // Сравнение с точностью EPSILON, как в IsMoreRelevant, не транзитивно, и страницы могли бы пересекаться.
+    // Поэтому релевантность округляется до EPSILON, а равные документы упорядочиваются по id
+    const auto precedes = [](const Document& lhs, const Document& rhs) {
+        const auto lhs_relevance = std::llround(lhs.relevance / EPSILON);
+        const auto rhs_relevance = std::llround(rhs.relevance / EPSILON);
+        if (lhs_relevance != rhs_relevance) {
+            return lhs_relevance > rhs_relevance;
+        }
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    };
+
+    if (cursor) {
+        const Document last_document(cursor->document_id, cursor->relevance, cursor->rating);
+        documents.erase(
+            std::remove_if(documents.begin(), documents.end(),
+                [&precedes, &last_document](const Document& document) {
+                    return !precedes(last_document, document);
+                }),
+            documents.end());
+    }
+
+    SearchPage page;
+    const bool has_next_page = documents.size() > page_size;
+    const auto page_end = documents.begin() + std::min(page_size, documents.size());
+    std::partial_sort(documents.begin(), page_end, documents.end(), precedes);
+    documents.erase(page_end, documents.end());
+    if (has_next_page) {
+        const Document& last_document = documents.back();
+        page.next_cursor = SearchCursor{ last_document.relevance, last_document.rating, last_document.id };
+    }
+    page.documents = std::move(documents);
+    return page;
+}
+
+std::vector<std::pair<uint32_t, uint64_t>> SearchServer::MakeSortedTerms(const std::vector<std::string_view>& words) const {
+    std::vector<std::pair<uint32_t, uint64_t>> terms;
+    terms.reserve(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        const auto it = word_to_term_id_.find(words[i]);
+        if (it != word_to_term_id_.end()) {
+            // у минус-слов важно только наличие, поэтому их может быть больше 64
+            terms.emplace_back(it->second, uint64_t{ 1 } << (i % 64));
+        }
+    }
+    std::sort(terms.begin(), terms.end());
+    return terms;
+}
+
+uint64_t SearchServer::MatchSortedTerms(const DocumentData& document, const std::vector<std::pair<uint32_t, uint64_t>>& terms) {
+    const DocumentTerm* const first = document.terms.get();
+    const DocumentTerm* const last = first + document.term_count;
+    uint64_t matched_words = 0;
+
+    // Для коротких запросов дешевле искать каждое слово, для длинных — пройти оба списка слиянием
+    if (terms.size() * std::log2(document.term_count + 1.0) < document.term_count + terms.size()) {
+        for (const auto& [term_id, bit] : terms) {
+            if (ContainsTerm(first, last, term_id)) {
+                matched_words |= bit;
+            }
+        }
+        return matched_words;
+    }
+
+    const DocumentTerm* it = first;
+    for (const auto& [term_id, bit] : terms) {
+        while (it != last && it->term_id < term_id) {
+            ++it;
+        }
+        if (it == last) {
+            break;
+        }
+        if (it->term_id == term_id) {
+            matched_words |= bit;
+        }
+    }
+    return matched_words;
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -165,6 +846,13 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
+double SearchServer::ComputeDocumentNorm(uint32_t word_count) const {
+    if (scoring_model_ == ScoringModel::BM25) {
+        return Bm25Scoring::ComputeDocumentNorm(word_count);
+    }
+    return TfIdfScoring::ComputeDocumentNorm(word_count);
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
     QueryWord result;
 
@@ -179,37 +867,106 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
     if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
         throw std::invalid_argument("наличие более чем одного минуса перед словами"s);
     }
+    if (text.back() == '*') {
+        text.remove_suffix(1);
+        if (text.empty()) {
+            throw std::invalid_argument("пустой префикс перед символом «звёздочка» в поисковом запросе"s);
+        }
+        return { text, is_minus, false, true };
+    }
+
+    return { text, is_minus, IsStopWord(text), false };
+}
+
+void SearchServer::AddQueryWord(const QueryWord& query_word, Query& query) const {
+    if (query_word.is_stop) {
+        return;
+    }
+    std::vector<std::string_view>& words = query_word.is_minus ? query.minus_words : query.plus_words;
+    // При поиске с опечатками расстояние есть у каждого плюс-слова
+    const bool is_fuzzy = fuzzy_index_ && !query_word.is_minus;
+    const size_t first_added = words.size();
+    if (is_fuzzy && !query_word.is_prefix) {
+        const bool is_collecting = QueryStatsCollector::GetCurrent() != nullptr;
+        const auto start = is_collecting ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+        const std::vector<std::pair<int, uint32_t>> fuzzy_terms = FindFuzzyTerms(query_word.data);
+        if (is_collecting) {
+            query.candidate_generation_time += std::chrono::steady_clock::now() - start;
+        }
+
+        for (const auto& [distance, term_id] : fuzzy_terms) {
+            words.push_back(terms_[term_id].word);
+            query.plus_word_edit_distances.push_back(distance);
+            query.fuzzy_word_count += distance > 0;
+        }
+        // Слово без близких слов в словаре остаётся в запросе и отбрасывается при планировании
+        if (fuzzy_terms.empty()) {
+            words.push_back(query_word.data);
+            query.plus_word_edit_distances.push_back(0);
+        }
+        return;
+    }
+    if (!query_word.is_prefix) {
+        words.push_back(query_word.data);
+        if (is_fuzzy) {
+            query.plus_word_edit_distances.resize(words.size(), 0);
+        }
+        return;
+    }
 
-    return { text, is_minus, IsStopWord(text) };
+    // Словарь упорядочен, поэтому слова с префиксом идут в нём подряд
+    const std::string_view prefix = query_word.data;
+    size_t expansion_count = 0;
+    for (auto it = word_to_term_id_.lower_bound(prefix);
+        it != word_to_term_id_.end() && expansion_count < max_prefix_expansions_; ++it) {
+        const std::string_view word = it->first;
+        if (word.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        words.push_back(word);
+        ++expansion_count;
+    }
+    query.expanded_word_count += expansion_count;
+    if (is_fuzzy) {
+        query.plus_word_edit_distances.resize(first_added + expansion_count, 0);
+    }
 }
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
     Query result;
 
     for (auto word : SplitIntoWordsView(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            }
-            else {
-                result.plus_words.push_back(query_word.data);
-            }
-        }
+        AddQueryWord(ParseQueryWord(word), result);
     }
 
     sort(result.minus_words.begin(), result.minus_words.end());
-    sort(result.plus_words.begin(), result.plus_words.end());
-
     auto last_minus = unique(result.minus_words.begin(), result.minus_words.end());
-    auto last_plus = unique(result.plus_words.begin(), result.plus_words.end());
-
     size_t newSize = last_minus - result.minus_words.begin();
     result.minus_words.resize(newSize);
 
-    newSize = last_plus - result.plus_words.begin();
-    result.plus_words.resize(newSize);
+    if (result.plus_word_edit_distances.empty()) {
+        sort(result.plus_words.begin(), result.plus_words.end());
+        auto last_plus = unique(result.plus_words.begin(), result.plus_words.end());
+        newSize = last_plus - result.plus_words.begin();
+        result.plus_words.resize(newSize);
+        return result;
+    }
 
+    // Слово, найденное по нескольким словам запроса, остаётся с наименьшим расстоянием
+    std::vector<std::pair<std::string_view, int>> plus_words;
+    plus_words.reserve(result.plus_words.size());
+    for (size_t i = 0; i < result.plus_words.size(); ++i) {
+        plus_words.emplace_back(result.plus_words[i], result.plus_word_edit_distances[i]);
+    }
+    sort(plus_words.begin(), plus_words.end());
+    result.plus_words.clear();
+    result.plus_word_edit_distances.clear();
+    for (const auto& [word, distance] : plus_words) {
+        if (result.plus_words.empty() || result.plus_words.back() != word) {
+            result.plus_words.push_back(word);
+            result.plus_word_edit_distances.push_back(distance);
+        }
+    }
     return result;
 }
 
@@ -217,19 +974,307 @@ SearchServer::Query SearchServer::ParseQueryParallel(std::string_view text) cons
     Query result;
 
     for (auto word : SplitIntoWordsView(text)) {
-        const QueryWord query_word(ParseQueryWord(word));
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
+        AddQueryWord(ParseQueryWord(word), result);
+    }
+    return result;
+}
+
+SearchServer::QueryPlan SearchServer::PlanQuery(const Query& query) const {
+    QueryPlan plan;
+    plan.corpus = GetScoringCorpus();
+
+    // Частые слова пропускаются, только если в запросе есть редкое слово корпуса, иначе запрос
+    // не нашёл бы ни одного документа. Со статистикой корпуса редкое слово может отсутствовать в этом сервере
+    bool has_rare_word = false;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const std::string_view word = query.plus_words[i];
+        const int edit_distance = query.plus_word_edit_distances.empty() ? 0 : query.plus_word_edit_distances[i];
+        const double document_freq = GetWordDocumentFreq(word);
+        const bool is_soft_stop = IsSoftStopWord(plan.corpus, document_freq);
+        has_rare_word = has_rare_word || (document_freq > 0.0 && !is_soft_stop);
+
+        const auto it = word_to_term_id_.find(word);
+        if (it == word_to_term_id_.end()) {
+            plan.dropped_words.push_back(word);
+            continue;
+        }
+        const Postings* const postings = terms_[it->second].postings.get();
+        // Слово из всех документов не влияет на релевантность, но его документы остаются найденными
+        double inverse_document_freq = ComputeInverseDocumentFreq(plan.corpus, document_freq);
+        if (edit_distance > 0) {
+            inverse_document_freq *= std::pow(fuzzy_search_->distance_weight, edit_distance);
+        }
+        if (is_soft_stop) {
+            plan.soft_stop_terms.push_back({ word, it->second, postings, inverse_document_freq, edit_distance });
+            continue;
+        }
+        plan.plus_terms.push_back({ word, it->second, postings, inverse_document_freq, edit_distance });
+    }
+    if (!has_rare_word) {
+        plan.plus_terms.insert(plan.plus_terms.end(), plan.soft_stop_terms.begin(), plan.soft_stop_terms.end());
+        plan.soft_stop_terms.clear();
+    }
+    for (const std::string_view word : query.minus_words) {
+        const auto it = word_to_term_id_.find(word);
+        if (it != word_to_term_id_.end()) {
+            plan.minus_terms.push_back({ word, it->second, terms_[it->second].postings.get(), 0.0 });
+        }
+    }
+
+    const auto by_posting_count = [](const QueryTerm& lhs, const QueryTerm& rhs) {
+        return lhs.postings->size() < rhs.postings->size();
+    };
+    std::stable_sort(plan.plus_terms.begin(), plan.plus_terms.end(), by_posting_count);
+    std::stable_sort(plan.minus_terms.begin(), plan.minus_terms.end(), by_posting_count);
+
+    // Оценка стоимости в условных операциях над записями индекса.
+    // Число кандидатов оценивается в предположении независимости слов
+    const double document_count = std::max(1, GetDocumentCount());
+    double plus_postings = 0.0;
+    double missing_share = 1.0;
+    for (const QueryTerm& term : plan.plus_terms) {
+        plus_postings += term.postings->size();
+        missing_share *= 1.0 - term.postings->size() / document_count;
+    }
+    double minus_postings = 0.0;
+    double minus_probe_cost = 0.0;
+    for (const QueryTerm& term : plan.minus_terms) {
+        minus_postings += term.postings->size();
+        minus_probe_cost += std::log2(term.postings->size() + 2.0);
+    }
+    const double candidates = document_count * (1.0 - missing_share);
+    const double term_count = static_cast<double>(plan.plus_terms.size());
+
+    // При пословной обработке каждая запись — поиск в словаре кандидатов,
+    // при слиянии — вставка и извлечение из кучи по числу слов
+    const double term_at_a_time_cost = (plus_postings + minus_postings) * std::log2(candidates + 2.0);
+    const double merge_cost = plus_postings * (2.0 * std::log2(term_count + 1.0) + 1.0);
+    const double document_at_a_time_cost = merge_cost + minus_postings;
+    const double intersection_cost = merge_cost + candidates * minus_probe_cost;
+
+    plan.strategy = QueryStrategy::TERM_AT_A_TIME;
+    plan.estimated_postings = static_cast<size_t>(plus_postings + minus_postings);
+    double best_cost = term_at_a_time_cost;
+    if (document_at_a_time_cost < best_cost) {
+        plan.strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+        best_cost = document_at_a_time_cost;
+    }
+    if (!plan.minus_terms.empty() && intersection_cost < best_cost) {
+        plan.strategy = QueryStrategy::INTERSECTION;
+        plan.estimated_postings = static_cast<size_t>(plus_postings + candidates * plan.minus_terms.size());
+    }
+
+    return plan;
+}
+
+SearchServer::QueryPlan SearchServer::PlanQuery(std::string_view raw_query, QueryStats& stats) const {
+    const bool is_collecting = QueryStatsCollector::GetCurrent() != nullptr;
+    const auto parse_start = is_collecting ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    const Query query = ParseQuery(raw_query);
+    if (is_collecting) {
+        stats.parse_time += std::chrono::steady_clock::now() - parse_start;
+    }
+
+    QueryPlan plan = PlanQuery(query);
+    stats.resolved_terms += plan.plus_terms.size() + plan.minus_terms.size();
+    stats.dropped_terms += plan.dropped_words.size();
+    stats.soft_stop_terms += plan.soft_stop_terms.size();
+    stats.expanded_terms += query.expanded_word_count;
+    stats.fuzzy_terms += query.fuzzy_word_count;
+    stats.candidate_generation_time += query.candidate_generation_time;
+    return plan;
+}
+
+void SearchServer::CollectQueryStats(QueryStats& stats, std::chrono::steady_clock::time_point sort_start) {
+    stats.sort_time += std::chrono::steady_clock::now() - sort_start;
+    ++stats.query_count;
+    *QueryStatsCollector::GetCurrent() += stats;
+}
+
+SearchServer::PoolQueryScratch& SearchServer::GetThreadPoolQueryScratch() {
+    thread_local PoolQueryScratch scratch;
+    return scratch;
+}
+
+size_t SearchServer::CountResultAllocations(size_t capacity, size_t size) {
+    // вектор растёт удвоением ёмкости
+    size_t allocation_count = 0;
+    for (; capacity < size; capacity = std::max<size_t>(1, capacity * 2)) {
+        ++allocation_count;
+    }
+    return allocation_count;
+}
+
+SearchServer::ImpactPostings::ImpactPostings(const CountingAllocator<char>& allocator)
+    : documents(allocator)
+    , segments(allocator)
+{
+}
+
+SearchServer::ImpactIndex::ImpactIndex(const CountingAllocator<char>& allocator)
+    : documents(allocator)
+    , terms(allocator)
+{
+}
+
+bool SearchServer::IsRankedByImpact() const noexcept {
+    // IDF из общей статистики корпуса меняется без ведома сервера, и вклады могли устареть.
+    // Вклады посчитаны с полным весом слов, а слова, найденные с опечатками, весят меньше
+    return ranking_mode_ == RankingMode::IMPACT_ORDERED && impact_index_ && corpus_statistics_ == nullptr && !fuzzy_search_;
+}
+
+void SearchServer::BuildImpactIndex() {
+    const CountingAllocator<char> allocator = CountAllocationsIn(&MemoryCounters::impacts);
+    const auto index = std::allocate_shared<ImpactIndex>(allocator, allocator);
+
+    index->documents.reserve(documents_.size());
+    for (const auto& [document_id, document] : documents_) {
+        index->documents.push_back({ document_id, document.rating, document.status, document.norm });
+    }
+
+    std::vector<double> inverse_document_freqs(terms_.size(), 0.0);
+    // (вклад, порядковый номер документа) для каждого слова
+    std::vector<std::vector<std::pair<double, uint32_t>>> term_impacts(terms_.size());
+    double max_impact = 0.0;
+    VisitScoringModel(scoring_model_, GetScoringCorpus(), [&](const auto& scoring) {
+        for (uint32_t term_id = 0; term_id < terms_.size(); ++term_id) {
+            if (terms_[term_id].postings) {
+                inverse_document_freqs[term_id] = scoring.ComputeInverseDocumentFreq(static_cast<double>(terms_[term_id].postings->size()));
+                term_impacts[term_id].reserve(terms_[term_id].postings->size());
             }
-            else {
-                result.plus_words.push_back(query_word.data);
+        }
+
+        // Прямой индекс даёт записи всех слов за один проход по документам без поиска их номеров
+        uint32_t next_document_index = 0;
+        for (const auto& [document_id, document] : documents_) {
+            for (const DocumentTerm* term = document.terms.get(); term != document.terms.get() + document.term_count; ++term) {
+                const double impact = scoring.ComputeTermWeight(term->count, document.norm) * inverse_document_freqs[term->term_id];
+                term_impacts[term->term_id].emplace_back(impact, next_document_index);
+                max_impact = std::max(max_impact, impact);
             }
+            ++next_document_index;
         }
+    });
+    if (max_impact > 0.0) {
+        index->impact_unit = max_impact / std::numeric_limits<uint16_t>::max();
     }
-    return result;
+
+    index->terms.reserve(terms_.size());
+    for (std::vector<std::pair<double, uint32_t>>& impacts : term_impacts) {
+        ImpactPostings& postings = index->terms.emplace_back(allocator);
+        std::sort(impacts.begin(), impacts.end(),
+            [](const std::pair<double, uint32_t>& lhs, const std::pair<double, uint32_t>& rhs) {
+                return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+        });
+        postings.documents.reserve(impacts.size());
+        for (const auto& [impact, document_index] : impacts) {
+            const uint16_t quantized_impact = QuantizeImpact(impact, index->impact_unit);
+            if (postings.segments.empty() || postings.segments.back().impact != quantized_impact) {
+                postings.segments.push_back({ 0, quantized_impact });
+            }
+            postings.documents.push_back(document_index);
+            postings.segments.back().end = static_cast<uint32_t>(postings.documents.size());
+        }
+    }
+    impact_index_ = index;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word ) const {
-    return std::log( GetDocumentCount() * 1.0 / word_to_document_freqs_.at( word ).size() );
-}
\ No newline at end of file
+bool SearchServer::SelectImpactCandidates(size_t top_count, uint64_t remaining_impact, SearchResultBuffer& buffer) const {
+    // Такая доля кандидатов сверх top_count ещё дешевле, чем просмотр оставшихся записей
+    static constexpr size_t MAX_CANDIDATES_PER_RESULT = 4;
+    using ImpactState = SearchResultBuffer::ImpactState;
+
+    // Вклад записи с квантованным вкладом q лежит в ((q - 1) * impact_unit, q * impact_unit].
+    // Поэтому сумма вкладов без числа слов — нижняя граница релевантности документа,
+    // а сумма вместе с remaining_impact — верхняя
+    const double impact_unit = impact_index_->impact_unit;
+    std::vector<uint64_t>& lower_bounds = buffer.impact_bounds_;
+    lower_bounds.clear();
+    for (const uint32_t document_index : buffer.touched_documents_) {
+        const SearchResultBuffer::ImpactAccumulator& accumulator = buffer.impact_accumulators_[document_index];
+        if (accumulator.state == ImpactState::ADMISSIBLE) {
+            lower_bounds.push_back(accumulator.impact_sum - accumulator.term_count);
+        }
+    }
+
+    // Документ с верхней границей ниже порога уступает top_count документам больше чем на EPSILON
+    // и не обгонит их даже с большим рейтингом
+    double threshold = std::numeric_limits<double>::lowest();
+    if (lower_bounds.size() >= top_count) {
+        std::nth_element(lower_bounds.begin(), lower_bounds.begin() + (top_count - 1), lower_bounds.end(), std::greater<>());
+        threshold = lower_bounds[top_count - 1] * impact_unit - 2 * EPSILON;
+    }
+    // Документ, ещё не встреченный ни в одном списке, может попасть в лучшие
+    if (remaining_impact > 0 && remaining_impact * impact_unit >= threshold) {
+        return false;
+    }
+
+    buffer.impact_candidates_.clear();
+    for (const uint32_t document_index : buffer.touched_documents_) {
+        const SearchResultBuffer::ImpactAccumulator& accumulator = buffer.impact_accumulators_[document_index];
+        if (accumulator.state == ImpactState::ADMISSIBLE
+            && (accumulator.impact_sum + remaining_impact) * impact_unit >= threshold) {
+            buffer.impact_candidates_.push_back(document_index);
+        }
+    }
+    return remaining_impact == 0 || buffer.impact_candidates_.size() <= MAX_CANDIDATES_PER_RESULT * top_count;
+}
+
+void SearchServer::ScoreImpactCandidates(const QueryPlan& plan, SearchResultBuffer& buffer) const {
+    const std::vector<uint32_t>& candidates = buffer.impact_candidates_;
+    std::vector<uint32_t>& counts = buffer.candidate_counts_;
+    std::vector<double>& norms = buffer.candidate_norms_;
+    std::vector<double>& relevances = buffer.candidate_relevances_;
+    norms.clear();
+    for (const uint32_t document_index : candidates) {
+        norms.push_back(impact_index_->documents[document_index].norm);
+    }
+    relevances.assign(candidates.size(), 0.0);
+
+    // Вклады слов складываются в порядке плана, как при полном переборе, поэтому релевантность совпадает с ним точно:
+    // у отсутствующего в документе слова нулевой вес, и его прибавление сумму не меняет
+    VisitScoringModel(scoring_model_, plan.corpus, [&](const auto& scoring) {
+        for (const QueryTerm& term : plan.plus_terms) {
+            counts.clear();
+            for (const uint32_t document_index : candidates) {
+                const auto it = term.postings->find(impact_index_->documents[document_index].id);
+                counts.push_back(it != term.postings->end() ? it->second : 0);
+            }
+            AccumulateTermScores(scoring, term.inverse_document_freq, counts.data(), norms.data(), candidates.size(), relevances.data());
+        }
+    });
+
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const ImpactDocument& document = impact_index_->documents[candidates[i]];
+        buffer.matched_documents_.push_back({ document.id, relevances[i], document.rating });
+    }
+
+    for (const uint32_t document_index : buffer.touched_documents_) {
+        buffer.impact_accumulators_[document_index] = {};
+    }
+}
+
+ScoringCorpus SearchServer::GetScoringCorpus() const {
+    const double document_count = corpus_statistics_ ? corpus_statistics_->document_count : GetDocumentCount();
+    const double word_count = static_cast<double>(corpus_statistics_ ? corpus_statistics_->word_count : total_word_count_);
+    return { document_count, document_count > 0.0 ? word_count / document_count : 0.0 };
+}
+
+double SearchServer::GetWordDocumentFreq(std::string_view word) const {
+    if (corpus_statistics_) {
+        const auto it = corpus_statistics_->document_freqs.find(word);
+        return it == corpus_statistics_->document_freqs.end() ? 0.0 : it->second;
+    }
+    const Postings* const postings = FindPostings(word);
+    return postings == nullptr ? 0.0 : static_cast<double>(postings->size());
+}
+
+double SearchServer::ComputeInverseDocumentFreq(const ScoringCorpus& corpus, double document_freq) const {
+    return VisitScoringModel(scoring_model_, corpus,
+        [document_freq](const auto& scoring) {
+            return scoring.ComputeInverseDocumentFreq(document_freq);
+    });
+}
+bool SearchServer::IsSoftStopWord(const ScoringCorpus& corpus, double document_freq) const {
+    return soft_stop_word_ratio_ && document_freq > *soft_stop_word_ratio_ * corpus.document_count;
+}
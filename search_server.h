@@ -1,42 +1,340 @@
 #pragma once
 
 #include "document.h"
+#include "fuzzy_term_index.h"
 #include "string_processing.h"
 #include "log_duration.h"
 #include "concurrent_map.h"
-#include "log_duration.h"
+#include "thread_pool.h"
+#include "query_stats.h"
+#include "memory_accounting.h"
+#include "scoring.h"
+#include "shared_containers.h"
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <algorithm>
 #include <stdexcept>
 #include <cmath>
 #include <execution>
+#include <type_traits>
+#include <chrono>
+#include <limits>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <iterator>
+#include <tuple>
 
 using namespace std::string_literals;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 inline static constexpr double EPSILON = 1e-6;
 
+// Ограничение на время и объём работы одного запроса
+struct SearchBudget {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    size_t max_postings = std::numeric_limits<size_t>::max();
+};
+
+// Поиск с опечатками: плюс-слово запроса заменяется близкими словами словаря
+struct FuzzySearchOptions {
+    // наибольшее расстояние Дамерау — Левенштейна до слова словаря: 1 или 2
+    int max_edit_distance = 1;
+    // наибольшее число слов словаря вместо одного слова запроса. Сначала берутся ближайшие,
+    // а среди них — слова с большим числом документов
+    size_t max_expansions = 8;
+    // вес слова на расстоянии k — distance_weight в степени k, число из (0, 1]
+    double distance_weight = 0.5;
+};
+
+// Результат поиска с ограничением: is_partial означает, что часть слов запроса не обработана
+struct BudgetedSearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
+
+// Позиция в результатах поиска: последний документ предыдущей страницы
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = 0;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // курсор следующей страницы или nullopt, если страница последняя
+    std::optional<SearchCursor> next_cursor;
+};
+
+// Рабочая память поиска. Если переиспользовать буфер между запросами одного потока,
+// найденные документы не требуют выделения памяти после первых запросов
+class SearchResultBuffer {
+private:
+    friend class SearchServer;
+
+    enum class ImpactState : uint8_t {
+        UNSEEN,
+        ADMISSIBLE,
+        // документ не прошёл фильтр
+        REJECTED,
+        // документ содержит минус-слово
+        EXCLUDED
+    };
+
+    // Сумма квантованных вкладов просмотренных слов документа при ранжировании по вкладам
+    struct ImpactAccumulator {
+        uint32_t impact_sum = 0;
+        uint16_t term_count = 0;
+        ImpactState state = ImpactState::UNSEEN;
+    };
+
+    std::vector<Document> matched_documents_;
+    // Накопители по порядковым номерам документов. Между запросами все они нулевые:
+    // после запроса сбрасываются только затронутые
+    std::vector<ImpactAccumulator> impact_accumulators_;
+    std::vector<uint32_t> touched_documents_;
+    std::vector<uint32_t> impact_candidates_;
+    std::vector<uint64_t> impact_bounds_;
+    // Плоские массивы кандидатов для точного подсчёта релевантности
+    std::vector<uint32_t> candidate_counts_;
+    std::vector<double> candidate_norms_;
+    std::vector<double> candidate_relevances_;
+};
+
+enum class QueryStrategy {
+    // релевантность накапливается по очереди для каждого слова
+    TERM_AT_A_TIME,
+    // списки документов плюс-слов сливаются по возрастанию id, минус-слова проходятся тем же слиянием
+    DOCUMENT_AT_A_TIME,
+    // как DOCUMENT_AT_A_TIME, но кандидаты проверяются поиском в списках минус-слов
+    INTERSECTION
+};
+
+// Способ поиска лучших документов
+enum class RankingMode {
+    // релевантность считается для всех документов с плюс-словами
+    EXHAUSTIVE,
+    // записи индекса просматриваются по убыванию вклада в релевантность, и поиск останавливается,
+    // когда лучшие документы уже не могут измениться
+    IMPACT_ORDERED
+};
+
+struct QueryTermExplanation {
+    std::string_view word;
+    bool is_minus = false;
+    // слово не участвует в поиске: его нет в индексе
+    bool is_dropped = false;
+    size_t document_freq = 0;
+    double inverse_document_freq = 0.0;
+    // частое плюс-слово, пропущенное при подсчёте релевантности
+    bool is_soft_stop = false;
+    // расстояние до слова запроса, если слово найдено поиском с опечатками
+    int edit_distance = 0;
+};
+
+// План выполнения запроса, оценка и фактическое число просмотренных записей индекса
+struct QueryExplanation {
+    QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+    std::vector<QueryTermExplanation> terms;
+    size_t estimated_postings = 0;
+    size_t actual_postings = 0;
+};
+
+// Результат сопоставления документа с запросом: бит i установлен, если в документе есть i-е плюс-слово
+struct DocumentMatch {
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    uint64_t matched_words = 0;
+};
+
+struct MatchedDocuments {
+    // Плюс-слова запроса в порядке номеров битов
+    std::vector<std::string_view> plus_words;
+    std::vector<DocumentMatch> matches;
+};
+
+// Статистика корпуса, по которой считается IDF. Нужна, когда документы одного корпуса
+// распределены между несколькими серверами и релевантность должна считаться по всему корпусу
+struct CorpusStatistics {
+    int document_count = 0;
+    // суммарное число слов документов без стоп-слов, по нему BM25 считает среднюю длину документа
+    uint64_t word_count = 0;
+    // число документов корпуса, содержащих слово
+    std::map<std::string, int, std::less<>> document_freqs;
+};
+
+class SearchServer;
+
+// Слово документа в прямом индексе: номер слова в словаре сервера и число вхождений слова в документ
+struct DocumentTerm {
+    uint32_t term_id = 0;
+    uint32_t count = 0;
+};
+
+// Частоты слов документа без копирования: слова берутся из словаря сервера.
+// Слова идут по возрастанию номеров в словаре. Представление действительно, пока сервер не изменяется
+class WordFrequenciesView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const SearchServer* search_server, const DocumentTerm* term, uint32_t word_count) noexcept
+            : search_server_(search_server), term_(term), word_count_(word_count)
+        {
+        }
+
+        // слово и его частота в документе
+        value_type operator*() const;
+
+        Iterator& operator++() noexcept {
+            ++term_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const noexcept {
+            return term_ == other.term_;
+        }
+
+        bool operator!=(const Iterator& other) const noexcept {
+            return term_ != other.term_;
+        }
+
+    private:
+        const SearchServer* search_server_;
+        const DocumentTerm* term_;
+        uint32_t word_count_;
+    };
+
+    WordFrequenciesView() = default;
+
+    Iterator begin() const noexcept {
+        return Iterator(search_server_, terms_, word_count_);
+    }
+
+    Iterator end() const noexcept {
+        return Iterator(search_server_, terms_ + size_, word_count_);
+    }
+
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    // число слов документа без стоп-слов
+    uint32_t GetWordCount() const noexcept {
+        return word_count_;
+    }
+
+private:
+    friend class SearchServer;
+
+    WordFrequenciesView(const SearchServer* search_server, const DocumentTerm* terms, size_t size, uint32_t word_count) noexcept
+        : search_server_(search_server), terms_(terms), size_(size), word_count_(word_count)
+    {
+    }
+
+    const SearchServer* search_server_ = nullptr;
+    const DocumentTerm* terms_ = nullptr;
+    size_t size_ = 0;
+    uint32_t word_count_ = 0;
+};
+
+// Память индекса по структурам в байтах и размеры индекса
+struct IndexMemoryStatistics {
+    size_t stop_words_bytes = 0;
+    size_t documents_bytes = 0;
+    // словарь и списки документов слов
+    size_t word_to_document_freqs_bytes = 0;
+    // прямой индекс: номера слов документов
+    size_t document_terms_bytes = 0;
+    // тексты документов, которые сервер скопировал при разборе, пока документы не добавлены.
+    // Добавленные документы текстов не хранят
+    size_t text_bytes = 0;
+    // списки документов, упорядоченные по вкладу в релевантность
+    size_t impact_bytes = 0;
+    // индекс удалений для поиска с опечатками
+    size_t fuzzy_index_bytes = 0;
+
+    size_t document_count = 0;
+    size_t vocabulary_size = 0;
+    // число записей (слово, документ) во всех списках документов
+    size_t posting_count = 0;
+
+    size_t GetTotalBytes() const;
+    double GetAveragePostingLength() const;
+};
+
+// Документ не добавлен: память индекса превысила заданный предел
+class MemoryBudgetExceeded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Документ, разобранный без изменения индекса
+struct PreparedDocument {
+    int id = 0;
+    int rating = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    // владелец памяти, в которой лежит текст документа
+    std::shared_ptr<const void> text;
+    // различные слова документа по алфавиту и число их вхождений, слова ссылаются на текст
+    std::vector<std::pair<std::string_view, uint32_t>> word_counts;
+    // число слов документа без стоп-слов
+    uint32_t word_count = 0;
+};
+
 class SearchServer {
+private:
+    struct DocumentData;
+
 public:
+    // Обходит id документов по возрастанию
+    using DocumentIdIterator = SharedSortedMap<int, DocumentData>::const_key_iterator;
+
+    static constexpr size_t DEFAULT_MAX_PREFIX_EXPANSIONS = 32;
+
+    // Модель релевантности задаётся при создании: от неё зависят нормировки документов в индексе
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    explicit SearchServer(const StringContainer& stop_words, ScoringModel scoring_model = ScoringModel::TF_IDF);
 
-    explicit SearchServer(const std::string& stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text))
+    explicit SearchServer(const std::string& stop_words_text, ScoringModel scoring_model = ScoringModel::TF_IDF)
+        : SearchServer(SplitIntoWords(stop_words_text), scoring_model)
     {
     }
     
-    explicit SearchServer(std::string_view stop_words_text)
-        : SearchServer(SplitIntoWordsView(stop_words_text))
+    explicit SearchServer(std::string_view stop_words_text, ScoringModel scoring_model = ScoringModel::TF_IDF)
+        : SearchServer(SplitIntoWordsView(stop_words_text), scoring_model)
     {
     }
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Проверяет и разбирает документ, не изменяя индекс. Можно вызывать из нескольких
+    // потоков одновременно, пока сервер не изменяется
+    PreparedDocument PrepareDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) const;
+    // Документ не копируется: document должен лежать в памяти, которой владеет text_owner
+    PreparedDocument PrepareDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings,
+        std::shared_ptr<const void> text_owner) const;
+
+    // Добавляет пакет подготовленных документов: записи группируются по словам,
+    // и список документов каждого слова дополняется один раз.
+    // При повторе id пакет не добавляется целиком
+    template <typename ExecutionPolicy>
+    void AddDocuments(ExecutionPolicy&& policy, std::vector<PreparedDocument> documents);
+    void AddDocuments(std::vector<PreparedDocument> documents);
+
     template <typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
@@ -51,33 +349,234 @@ public:
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // Записывает до output_size лучших документов в output и возвращает их число.
+    // ResultDocument — Document или PackedDocument. Результаты не выделяют память,
+    // если buffer уже использовался для запросов с не меньшим числом найденных документов
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename ResultDocument>
+    size_t FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+        SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const;
+    template <typename DocumentPredicate, typename ResultDocument>
+    size_t FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+        SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const;
+    template <typename ResultDocument>
+    size_t FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+        SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const;
+    template <typename ResultDocument>
+    size_t FindTopDocuments(std::string_view raw_query, SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const;
+
+    // Слова запроса обрабатываются от редких к частым, пока не исчерпан бюджет.
+    // Минус-слова учитываются всегда
+    template <typename DocumentPredicate>
+    BudgetedSearchResult FindTopDocuments(std::string_view raw_query, const SearchBudget& budget, DocumentPredicate document_predicate) const;
+    BudgetedSearchResult FindTopDocuments(std::string_view raw_query, const SearchBudget& budget, DocumentStatus status) const;
+    BudgetedSearchResult FindTopDocuments(std::string_view raw_query, const SearchBudget& budget) const;
+
+    // Возвращает до page_size документов, следующих в порядке результатов за cursor
+    // (с начала, если cursor не задан). Ограничение MAX_RESULT_DOCUMENT_COUNT не действует.
+    // Релевантность сравнивается с округлением до EPSILON, документы с равными релевантностью
+    // и рейтингом упорядочены по id, поэтому страницы не пересекаются
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    SearchPage FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor,
+        DocumentPredicate document_predicate) const;
+    template <typename DocumentPredicate>
+    SearchPage FindTopDocuments(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor, DocumentPredicate document_predicate) const;
+    SearchPage FindTopDocuments(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor, DocumentStatus status) const;
+    SearchPage FindTopDocuments(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor) const;
+
+    // Выполняет запрос по документам со статусом ACTUAL и описывает, как он был выполнен
+    QueryExplanation ExplainQuery(std::string_view raw_query) const;
+
     int GetDocumentCount() const;
 
-    const std::set<int>::const_iterator begin() const noexcept;
-    const std::set<int>::const_iterator end() const noexcept;
+    ScoringModel GetScoringModel() const noexcept;
+
+    // Память структур индекса и размеры индекса. Копии сервера разделяют списки документов
+    // и тексты и ведут общий учёт, поэтому байты показывают память всех копий вместе.
+    // Число записей считается обходом словаря
+    IndexMemoryStatistics GetMemoryStatistics() const;
+
+    // Задаёт предел памяти индекса в байтах, nullopt — без предела. Если занятая память вместе
+    // с разобранными документами больше предела, AddDocument и AddDocuments бросают
+    // MemoryBudgetExceeded, не изменяя индекс. Предел проверяется до добавления записей
+    // в списки документов, поэтому одно добавление может превысить его на их размер
+    void SetMemoryBudget(std::optional<size_t> max_bytes) noexcept;
+    bool IsMemoryBudgetExceeded() const noexcept;
+
+    // Задаёт статистику корпуса для расчёта IDF, nullptr — статистика самого сервера.
+    // Статистика должна учитывать все документы сервера и жить дольше него
+    void SetCorpusStatistics(const CorpusStatistics* statistics) noexcept;
+
+    // Задаёт способ поиска лучших документов. Для IMPACT_ORDERED вклады слов в релевантность документов
+    // вычисляются сразу, индекс как бы замораживается. Изменение документов сбрасывает вклады, и до вызова
+    // RefreshImpacts поиск выполняется полным перебором. Вклады используются в FindTopDocuments
+    // с ограниченным числом результатов и не используются со статистикой корпуса
+    void SetRankingMode(RankingMode mode);
+    RankingMode GetRankingMode() const noexcept;
+    // Пересчитывает вклады, сброшенные изменением документов, если выбран режим IMPACT_ORDERED
+    void RefreshImpacts();
+
+    // Плюс-слова, которые есть больше чем в доле ratio документов (мягкие стоп-слова), не участвуют
+    // в подсчёте релевантности: их IDF близок к нулю, а списки документов длинные. Минус-словами
+    // и в MatchDocument они учитываются. Если частые все плюс-слова запроса, они не пропускаются.
+    // nullopt — частые слова не пропускаются. Бросает invalid_argument, если ratio не в (0, 1]
+    void SetSoftStopWordRatio(std::optional<double> ratio);
+    std::optional<double> GetSoftStopWordRatio() const noexcept;
+    // Мягкие стоп-слова при текущем составе документов по алфавиту и доли содержащих их документов
+    std::vector<std::pair<std::string_view, double>> GetSoftStopWords() const;
+
+    // Слово запроса со звёздочкой на конце (cat*, -cat*) заменяется словами словаря с этим префиксом,
+    // не больше max_count первых по алфавиту. Остальные слова с префиксом в запросе не учитываются
+    void SetMaxPrefixExpansions(size_t max_count) noexcept;
+    size_t GetMaxPrefixExpansions() const noexcept;
+
+    // Включает поиск с опечатками или выключает его при nullopt. Включение строит индекс удалений
+    // по текущему словарю, после этого индекс пополняется вместе со словарём. Слова, найденные
+    // с опечатками, учитываются в FindTopDocuments с пониженным весом, а MatchDocument возвращает их
+    // наравне с точными. Пока поиск с опечатками включён, поиск по вкладам не используется.
+    // Бросает invalid_argument при недопустимых параметрах
+    void SetFuzzySearch(std::optional<FuzzySearchOptions> options);
+    const std::optional<FuzzySearchOptions>& GetFuzzySearch() const noexcept;
+
+    // Порядок документов в результатах поиска
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+    DocumentIdIterator begin() const noexcept;
+    DocumentIdIterator end() const noexcept;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ThreadPool& pool, std::string_view raw_query, int document_id) const;
+
+    // Сопоставляет запрос сразу с несколькими документами: запрос разбирается один раз,
+    // а найденные слова возвращаются битовыми масками без выделения памяти на каждый документ
+    template <typename ExecutionPolicy, typename DocumentIds>
+    MatchedDocuments MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentIds& document_ids) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Для отсутствующего документа возвращает пустое представление
+    WordFrequenciesView GetWordFrequencies(int document_id) const;
 
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
+    void RemoveDocument(ThreadPool& pool, int document_id);
     void RemoveDocument(int document_id);
 
+    // Удаляет пакет документов: изменения группируются по словам,
+    // и список документов каждого слова перестраивается один раз
+    template <typename ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
 private:
+    friend class WordFrequenciesView::Iterator;
+
+    // Слова документов пакета хранятся в одном блоке, документ ссылается на свою часть блока.
+    // Блок освобождается, когда удалены все его документы
+    using DocumentTermBlock = std::vector<DocumentTerm, CountingAllocator<DocumentTerm>>;
+
     struct DocumentData {
         int rating;
         DocumentStatus status;
-        std::string text_;
+        // слова документа по возрастанию номеров
+        std::shared_ptr<const DocumentTerm> terms;
+        uint32_t term_count;
+        // число слов документа без стоп-слов, частота слова равна числу его вхождений, делённому на него
+        uint32_t word_count;
+        // нормировка документа по длине в модели релевантности сервера
+        double norm;
+    };
+
+    using StopWordSet = std::set<CountedString, std::less<>, CountingAllocator<CountedString>>;
+    // id документа и число вхождений в него слова. Вес слова считается при поиске по нормировке документа.
+    // Копии списка разделяют неизменённые блоки
+    using Postings = SharedSortedMap<int, uint32_t>;
+
+    // Слово словаря. Номера удалённых слов переиспользуются, у свободного номера нет списка документов
+    struct Term {
+        CountedString word;
+        std::shared_ptr<Postings> postings;
     };
 
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    // Память каждой структуры учитывается в своём счётчике. Копии сервера разделяют счётчики
+    struct MemoryCounters {
+        MemoryCounter stop_words{ 0 };
+        MemoryCounter documents{ 0 };
+        MemoryCounter word_to_document_freqs{ 0 };
+        MemoryCounter document_terms{ 0 };
+        MemoryCounter texts{ 0 };
+        MemoryCounter impacts{ 0 };
+        MemoryCounter fuzzy_index{ 0 };
+    };
+
+    // Отрезок списка документов слова с одинаковым квантованным вкладом
+    struct ImpactSegment {
+        // конец отрезка в списке, начало — конец предыдущего отрезка
+        uint32_t end;
+        uint16_t impact;
+    };
+
+    // Список документов слова по убыванию вклада. Документы заданы порядковыми номерами
+    struct ImpactPostings {
+        explicit ImpactPostings(const CountingAllocator<char>& allocator);
+
+        std::vector<uint32_t, CountingAllocator<uint32_t>> documents;
+        std::vector<ImpactSegment, CountingAllocator<ImpactSegment>> segments;
+    };
+
+    struct ImpactDocument {
+        int id;
+        int rating;
+        DocumentStatus status;
+        double norm;
+    };
+
+    // Вклады слов в релевантность документов на момент заморозки индекса. Вклад записи — произведение
+    // веса слова в документе на IDF, он хранится в единицах impact_unit с округлением вверх
+    struct ImpactIndex {
+        explicit ImpactIndex(const CountingAllocator<char>& allocator);
+
+        double impact_unit = 1.0;
+        // документы по возрастанию id, место документа — его порядковый номер
+        std::vector<ImpactDocument, CountingAllocator<ImpactDocument>> documents;
+        // по номерам слов словаря
+        std::vector<ImpactPostings, CountingAllocator<ImpactPostings>> terms;
+    };
+
+    // Объявлены до контейнеров, потому что аллокаторы контейнеров ссылаются на счётчики
+    const std::shared_ptr<MemoryCounters> memory_counters_ = std::make_shared<MemoryCounters>();
+    std::optional<size_t> memory_budget_;
+
+    const StopWordSet stop_words_;
+    const ScoringModel scoring_model_;
+    // Словарь владеет словами, поэтому индекс не ссылается на тексты документов.
+    // Словарь, таблица слов, таблица документов, списки документов слов и блоки слов документов
+    // разделяются между копиями сервера. Перед изменением общая часть копируется (копирование при записи),
+    // поэтому копия сервера обходится в число блоков словаря и таблиц, а изменение копии —
+    // в размер затронутых блоков и списков, а не всего индекса
+    SharedSortedMap<CountedString, uint32_t> word_to_term_id_{ CountAllocationsIn(&MemoryCounters::word_to_document_freqs) };
+    SharedChunkedVector<Term> terms_{ CountAllocationsIn(&MemoryCounters::word_to_document_freqs) };
+    std::vector<uint32_t, CountingAllocator<uint32_t>> free_term_ids_{ CountAllocationsIn(&MemoryCounters::word_to_document_freqs) };
+    SharedSortedMap<int, DocumentData> documents_{ CountAllocationsIn(&MemoryCounters::documents) };
+    // суммарное число слов документов без стоп-слов
+    uint64_t total_word_count_ = 0;
+    const CorpusStatistics* corpus_statistics_ = nullptr;
+    RankingMode ranking_mode_ = RankingMode::EXHAUSTIVE;
+    std::optional<double> soft_stop_word_ratio_;
+    size_t max_prefix_expansions_ = DEFAULT_MAX_PREFIX_EXPANSIONS;
+    std::optional<FuzzySearchOptions> fuzzy_search_;
+    // Индекс удалений слов словаря, если включён поиск с опечатками.
+    // Разделяется между копиями сервера и копируется перед изменением
+    std::shared_ptr<FuzzyTermIndex> fuzzy_index_;
+    // Не изменяется и разделяется между копиями сервера. Сбрасывается при изменении документов
+    std::shared_ptr<const ImpactIndex> impact_index_;
+
+    // Аллокатор, учитывающий память в счётчике counter сервера
+    CountingAllocator<char> CountAllocationsIn(MemoryCounter MemoryCounters::* counter) const;
+
+    StopWordSet MakeStopWords(const std::set<std::string, std::less<>>& stop_words) const;
+
+    // Бросает MemoryBudgetExceeded, если память индекса превышает предел
+    void CheckMemoryBudget() const;
 
     bool IsStopWord(std::string_view word) const;
 
@@ -87,10 +586,79 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    double ComputeDocumentNorm(uint32_t word_count) const;
+
+    // Список документов слова или nullptr, если слова нет в словаре
+    const Postings* FindPostings(std::string_view word) const;
+
+    // Номер слова в словаре. Новое слово получает свободный номер без списка документов
+    uint32_t AcquireTermId(std::string_view word);
+
+    // Удаляет из словаря слово, которого больше нет ни в одном документе
+    void ReleaseTerm(uint32_t term_id);
+
+    // Возвращает индекс удалений, который можно менять, не затрагивая копии сервера
+    FuzzyTermIndex& GetMutableFuzzyIndex();
+
+    // Слова словаря на расстоянии не больше заданного от word: пары (расстояние, номер слова)
+    // в порядке отбора, не больше max_expansions
+    std::vector<std::pair<int, uint32_t>> FindFuzzyTerms(std::string_view word) const;
+
+    // Есть ли слово в документе. Номер слова ищется двоичным поиском среди слов документа
+    bool HasWord(const DocumentData& document, std::string_view word) const;
+
+    // Готовит удаление документа из инвертированного индекса: удаляет слова, которые есть
+    // только в этом документе. Возвращает списки документов оставшихся слов,
+    // из которых осталось удалить document_id
+    std::vector<Postings*> DetachDocumentWords(int document_id);
+
+    // Возвращает список документов слова, который можно менять, не затрагивая копии сервера
+    Postings& GetMutablePostings(std::shared_ptr<Postings>& postings);
+
+    // Добавления в список документов одного слова при пакетном добавлении
+    struct WordAddition {
+        Postings* postings;
+        // id добавляемых документов по возрастанию и число вхождений слова в них
+        std::vector<std::pair<int, uint32_t>> document_counts;
+    };
+
+    struct Addition {
+        std::vector<WordAddition> words;
+        // данные добавляемых документов в порядке возрастания id
+        std::vector<DocumentData> documents;
+    };
+
+    // Записывает слова документов в словарь и прямой индекс. Документы упорядочиваются по id
+    Addition PrepareAddition(std::vector<PreparedDocument>& documents);
+
+    void FinishAddition(const std::vector<PreparedDocument>& documents, std::vector<DocumentData>& document_data);
+
+    // Изменения списка документов одного слова при пакетном удалении
+    struct WordRemoval {
+        uint32_t term_id = 0;
+        // список документов слова, уже отделённый от копий сервера
+        Postings* postings = nullptr;
+        // id удаляемых документов по возрастанию
+        std::vector<int> document_ids;
+        // слово есть только в удаляемых документах
+        bool is_word_released = false;
+    };
+
+    std::vector<WordRemoval> PrepareRemoval(std::vector<int>& document_ids);
+
+    static void RemoveFromPostings(Postings& postings, const std::vector<int>& document_ids);
+
+    void FinishRemoval(const std::vector<int>& document_ids, const std::vector<WordRemoval>& removals);
+
+    // Удаляет документ из списка документов сервера. Списки документов слов должны быть уже изменены
+    void EraseDocument(int document_id);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        // data — префикс слов
+        bool is_prefix;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
@@ -98,26 +666,151 @@ private:
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        // слова словаря, подставленные вместо префиксов
+        size_t expanded_word_count = 0;
+        // При поиске с опечатками — расстояния до плюс-слов в порядке plus_words, иначе пусто
+        std::vector<int> plus_word_edit_distances;
+        // слова словаря, найденные с опечатками, и время их поиска
+        size_t fuzzy_word_count = 0;
+        std::chrono::nanoseconds candidate_generation_time{};
     };
 
+    // Добавляет слово запроса в query. Префикс заменяется словами словаря, которые ссылаются на словарь
+    void AddQueryWord(const QueryWord& query_word, Query& query) const;
+
     Query ParseQuery(std::string_view text) const;
     Query ParseQueryParallel(std::string_view text) const;
 
+    // Методы поиска дописывают в stats счётчики запроса. Счётчики считаются по словам
+    // и документам, а не по записям индекса, поэтому ведутся всегда
+
+    // Найденные документы записываются в matched_documents, прежнее содержимое удаляется.
+    // Память вектора переиспользуется, поэтому повторные запросы с одним вектором не выделяют её под результаты
+
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    void FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate, std::vector<Document>& matched_documents, QueryStats& stats) const;
 
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+        std::vector<Document>& matched_documents, QueryStats& stats) const;
     
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+        std::vector<Document>& matched_documents, QueryStats& stats) const;
+
+    template<typename DocumentPredicate>
+    void FindAllDocuments(ThreadPool& pool, std::string_view raw_query, DocumentPredicate document_predicate,
+        std::vector<Document>& matched_documents, QueryStats& stats) const;
+
+    template<typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(std::string_view raw_query, const SearchBudget& budget, DocumentPredicate document_predicate, bool& is_partial, QueryStats& stats) const;
+
+    struct QueryTerm {
+        std::string_view word;
+        uint32_t term_id;
+        const Postings* postings;
+        // IDF, умноженный на вес слова, найденного с опечатками
+        double inverse_document_freq;
+        int edit_distance = 0;
+    };
+
+    struct QueryPlan {
+        // Слова упорядочены по возрастанию длины списка документов
+        std::vector<QueryTerm> plus_terms;
+        std::vector<QueryTerm> minus_terms;
+        // Отсутствующие в индексе слова
+        std::vector<std::string_view> dropped_words;
+        // Плюс-слова, пропущенные как мягкие стоп-слова
+        std::vector<QueryTerm> soft_stop_terms;
+        QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+        size_t estimated_postings = 0;
+        // статистика, по которой модель релевантности считает веса слов
+        ScoringCorpus corpus;
+    };
+
+    QueryPlan PlanQuery(const Query& query) const;
+
+    // Разбирает и планирует запрос. Время разбора измеряется, только если задан сборщик статистики
+    QueryPlan PlanQuery(std::string_view raw_query, QueryStats& stats) const;
+
+    // Оставляет page_size первых документов после cursor. Сортируются только они, а не все найденные документы
+    static SearchPage SelectPage(std::vector<Document> documents, size_t page_size, const std::optional<SearchCursor>& cursor);
+
+    // Передаёт статистику запроса сборщику текущего потока
+    static void CollectQueryStats(QueryStats& stats, std::chrono::steady_clock::time_point sort_start);
+
+    template<typename DocumentPredicate>
+    void ExecuteQueryPlan(const QueryPlan& plan, DocumentPredicate document_predicate, std::vector<Document>& matched_documents, QueryStats& stats) const;
+
+    template<typename Scoring, typename DocumentPredicate>
+    void FindAllDocumentsTermAtATime(const QueryPlan& plan, const Scoring& scoring, DocumentPredicate document_predicate,
+        std::vector<Document>& matched_documents, QueryStats& stats) const;
+
+    // Число документов, релевантность которых при слиянии считается одним вызовом AccumulateTermScores
+    static constexpr size_t DOCUMENT_BLOCK_SIZE = 256;
+
+    template<typename Scoring, typename DocumentPredicate>
+    void FindAllDocumentsDocumentAtATime(const QueryPlan& plan, const Scoring& scoring, DocumentPredicate document_predicate,
+        std::vector<Document>& matched_documents, QueryStats& stats) const;
+
+    // Вклады вычислены после последнего изменения документов, и поиск может их использовать
+    bool IsRankedByImpact() const noexcept;
+
+    void BuildImpactIndex();
+
+    // Записывает в buffer лучшие документы с точной релевантностью, а также документы, которые
+    // по квантованным вкладам нельзя отделить от лучших. Записи всех слов просматриваются по убыванию
+    // вклада, пока top_count лучших документов не отделятся от остальных
+    template<typename DocumentPredicate>
+    void FindTopDocumentsByImpact(const QueryPlan& plan, DocumentPredicate document_predicate, size_t top_count,
+        SearchResultBuffer& buffer, QueryStats& stats) const;
+
+    // Отбирает кандидатов в лучшие документы. Возвращает false, если непросмотренные записи
+    // с суммой наибольших вкладов слов remaining_impact ещё могут изменить лучшие документы
+    bool SelectImpactCandidates(size_t top_count, uint64_t remaining_impact, SearchResultBuffer& buffer) const;
+
+    // Считает точную релевантность кандидатов и сбрасывает накопители
+    void ScoreImpactCandidates(const QueryPlan& plan, SearchResultBuffer& buffer) const;
+
+    // Число выделений памяти, если в вектор с ёмкостью capacity по одному добавлены size элементов
+    static size_t CountResultAllocations(size_t capacity, size_t size);
+
+    // Рабочая память запроса, выполняемого через пул: вклады (id документа, вклад) каждого исполнителя
+    // и их объединение. Вклады одного запроса разных исполнителей нельзя смешивать, а исполнитель
+    // между частями одного запроса может выполнять части другого. Поэтому память принадлежит
+    // потоку, вызвавшему запрос, и переиспользуется его следующими запросами
+    struct PoolQueryScratch {
+        std::vector<std::vector<std::pair<int, double>>> worker_contributions;
+        std::vector<size_t> worker_capacities;
+        std::vector<std::pair<int, double>> contributions;
+        // Занята запросом, который поток ещё выполняет: ожидая его, поток может взять из пула другой запрос
+        bool is_busy = false;
+    };
 
-    double ComputeWordInverseDocumentFreq(std::string_view word ) const;
+    static PoolQueryScratch& GetThreadPoolQueryScratch();
+
+    // Проверяет наличие слов в документе. terms — номера слов по возрастанию и их биты.
+    // Возвращает объединение битов найденных слов
+    static uint64_t MatchSortedTerms(const DocumentData& document, const std::vector<std::pair<uint32_t, uint64_t>>& terms);
+
+    // Номера слов из словаря по возрастанию, i-е слово получает бит i
+    std::vector<std::pair<uint32_t, uint64_t>> MakeSortedTerms(const std::vector<std::string_view>& words) const;
+
+    // Статистика корпуса сервера или общая статистика, если она задана
+    ScoringCorpus GetScoringCorpus() const;
+
+    // Число документов корпуса со словом, ноль для отсутствующего слова
+    double GetWordDocumentFreq(std::string_view word) const;
+
+    double ComputeInverseDocumentFreq(const ScoringCorpus& corpus, double document_freq) const;
+
+    bool IsSoftStopWord(const ScoringCorpus& corpus, double document_freq) const;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+SearchServer::SearchServer(const StringContainer& stop_words, ScoringModel scoring_model)
+    : stop_words_(MakeStopWords(MakeUniqueNonEmptyStrings(stop_words)))
+    , scoring_model_(scoring_model)
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("слово содержит специальный символ"s);
@@ -126,24 +819,64 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    auto matched_documents = FindAllDocuments(policy, raw_query, document_predicate);
+    SearchResultBuffer buffer;
+    std::vector<Document> result(MAX_RESULT_DOCUMENT_COUNT);
+    result.resize(FindTopDocuments(policy, raw_query, document_predicate, buffer, result.data(), result.size()));
+    return result;
+}
 
-    std::sort(policy,
-        matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
+template <typename DocumentPredicate, typename ExecutionPolicy, typename ResultDocument>
+size_t SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+    SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const {
+    QueryStats stats;
+    std::vector<Document>& matched_documents = buffer.matched_documents_;
+    if (IsRankedByImpact()) {
+        // Записи просматриваются по убыванию вклада последовательно, политика выполнения не нужна
+        FindTopDocumentsByImpact(PlanQuery(raw_query, stats), document_predicate, output_size, buffer, stats);
+    }
+    else {
+        FindAllDocuments(policy, raw_query, document_predicate, matched_documents, stats);
+    }
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    const bool is_collecting = QueryStatsCollector::GetCurrent() != nullptr;
+    const auto sort_start = is_collecting ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    const size_t result_size = std::min(output_size, matched_documents.size());
+    const auto result_end = matched_documents.begin() + result_size;
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPool>) {
+        std::partial_sort(matched_documents.begin(), result_end, matched_documents.end(), IsMoreRelevant);
     }
+    else {
+        std::partial_sort(policy, matched_documents.begin(), result_end, matched_documents.end(), IsMoreRelevant);
+    }
+    std::transform(matched_documents.begin(), result_end, output,
+        [](const Document& document) {
+            return ResultDocument(document);
+    });
 
-    return matched_documents;
+    if (is_collecting) {
+        CollectQueryStats(stats, sort_start);
+    }
+    return result_size;
+}
+
+template <typename DocumentPredicate, typename ResultDocument>
+size_t SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+    SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, buffer, output, output_size);
+}
+
+template <typename ResultDocument>
+size_t SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+    SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const {
+    return FindTopDocuments(std::execution::seq, raw_query,
+        [status](int document_id, DocumentStatus new_status, int rating) {
+            return new_status == status;
+        }, buffer, output, output_size);
+}
+
+template <typename ResultDocument>
+size_t SearchServer::FindTopDocuments(std::string_view raw_query, SearchResultBuffer& buffer, ResultDocument* output, size_t output_size) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, buffer, output, output_size);
 }
 
 template <typename DocumentPredicate>
@@ -164,134 +897,663 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, s
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
+template <typename DocumentPredicate>
+BudgetedSearchResult SearchServer::FindTopDocuments(std::string_view raw_query, const SearchBudget& budget, DocumentPredicate document_predicate) const {
+    BudgetedSearchResult result;
+    QueryStats stats;
+    result.documents = FindAllDocuments(raw_query, budget, document_predicate, result.is_partial, stats);
+
+    const bool is_collecting = QueryStatsCollector::GetCurrent() != nullptr;
+    const auto sort_start = is_collecting ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    std::sort(result.documents.begin(), result.documents.end(), IsMoreRelevant);
+    if (result.documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        result.documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+
+    if (is_collecting) {
+        CollectQueryStats(stats, sort_start);
+    }
+    return result;
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+SearchPage SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor,
+    DocumentPredicate document_predicate) const {
+    if (page_size == 0) {
+        throw std::invalid_argument("нулевой размер страницы"s);
+    }
+    QueryStats stats;
+    std::vector<Document> matched_documents;
+    FindAllDocuments(policy, raw_query, document_predicate, matched_documents, stats);
+
+    const bool is_collecting = QueryStatsCollector::GetCurrent() != nullptr;
+    const auto sort_start = is_collecting ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    SearchPage page = SelectPage(std::move(matched_documents), page_size, cursor);
+
+    if (is_collecting) {
+        CollectQueryStats(stats, sort_start);
+    }
+    return page;
+}
+
+template <typename DocumentPredicate>
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& cursor, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::seq, raw_query, page_size, cursor, document_predicate);
+}
+
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    std::map<int, double> document_to_relevance;
+void SearchServer::FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate, std::vector<Document>& matched_documents, QueryStats& stats) const {
+    FindAllDocuments(std::execution::seq, raw_query, document_predicate, matched_documents, stats);
+}
 
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const DocumentData& documents_data = documents_.at(document_id);
-            if (document_predicate(document_id, documents_data.status, documents_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
+template<typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+    std::vector<Document>& matched_documents, QueryStats& stats) const {
+    const QueryPlan plan = PlanQuery(raw_query, stats);
+    ExecuteQueryPlan(plan, document_predicate, matched_documents, stats);
+}
+
+template<typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+    std::vector<Document>& matched_documents, QueryStats& stats) const {
+    ConcurrentMap<int, double> document_to_relevance(16);
+    const QueryPlan plan = PlanQuery(raw_query, stats);
+
+    VisitScoringModel(scoring_model_, plan.corpus, [&](const auto& scoring) {
+        std::for_each(policy,
+            plan.plus_terms.begin(), plan.plus_terms.end(),
+            [this, &scoring, &document_predicate, &document_to_relevance](const QueryTerm& term) {
+                for (const auto& [document_id, count] : *term.postings) {
+                    const auto& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        document_to_relevance[document_id].ref_to_value
+                            += scoring.ComputeTermWeight(count, document_data.norm) * term.inverse_document_freq;
+                    }
+                }
+        });
+    });
+
+    for (const QueryTerm& term : plan.plus_terms) {
+        stats.scanned_postings += term.postings->size();
+        stats.predicate_calls += term.postings->size();
+    }
+
+    // Минус-слова исключаются после подсчёта релевантности, иначе плюс-слова вернут документ обратно
+    std::map<int, double> document_to_relevance_reduced = document_to_relevance.BuildOrdinaryMap();
+    const size_t scored_document_count = document_to_relevance_reduced.size();
+    for (const QueryTerm& term : plan.minus_terms) {
+        for (const auto& [document_id, _] : *term.postings) {
+            document_to_relevance_reduced.erase(document_id);
         }
+        stats.scanned_postings += term.postings->size();
     }
-    
-    for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    stats.scored_documents += scored_document_count;
+    stats.excluded_documents += scored_document_count - document_to_relevance_reduced.size();
+    // узлы словаря потоков, узлы общего словаря и результат
+    stats.allocations += 2 * scored_document_count + (matched_documents.capacity() < document_to_relevance_reduced.size());
+
+    matched_documents.clear();
+    matched_documents.reserve(document_to_relevance_reduced.size());
+    for (const auto [document_id, relevance] : document_to_relevance_reduced) {
+        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    }
+}
+
+template<typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(std::string_view raw_query, const SearchBudget& budget, DocumentPredicate document_predicate, bool& is_partial, QueryStats& stats) const {
+    // Проверять время на каждом документе дорого, поэтому часы опрашиваются раз в DEADLINE_CHECK_PERIOD документов
+    static constexpr size_t DEADLINE_CHECK_PERIOD = 1024;
+
+    // План уже упорядочивает слова от редких к частым: у редких больше IDF, и они дешевле обрабатываются
+    const QueryPlan plan = PlanQuery(raw_query, stats);
+    const bool has_deadline = budget.deadline != std::chrono::steady_clock::time_point::max();
+
+    is_partial = false;
+    size_t scanned_postings = 0;
+    std::map<int, double> document_to_relevance;
+    // Вклады слова копятся отдельно и попадают в релевантность, только если слово обработано целиком:
+    // иначе часть документов получила бы вес слова, а часть нет
+    std::vector<std::pair<int, double>> term_contributions;
+
+    VisitScoringModel(scoring_model_, plan.corpus, [&](const auto& scoring) {
+        for (const QueryTerm& term : plan.plus_terms) {
+            if (scanned_postings + term.postings->size() > budget.max_postings
+                || (has_deadline && std::chrono::steady_clock::now() >= budget.deadline)) {
+                is_partial = true;
+                break;
+            }
+            term_contributions.clear();
+            for (const auto& [document_id, count] : *term.postings) {
+                if (has_deadline && ++scanned_postings % DEADLINE_CHECK_PERIOD == 0
+                    && std::chrono::steady_clock::now() >= budget.deadline) {
+                    is_partial = true;
+                    break;
+                }
+                const auto& document_data = documents_.at(document_id);
+                if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                    term_contributions.emplace_back(document_id, scoring.ComputeTermWeight(count, document_data.norm) * term.inverse_document_freq);
+                }
+            }
+            if (is_partial) {
+                break;
+            }
+            for (const auto& [document_id, weight] : term_contributions) {
+                document_to_relevance[document_id] += weight;
+            }
+            if (!has_deadline) {
+                scanned_postings += term.postings->size();
+            }
         }
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
+    });
+
+    stats.scanned_postings += scanned_postings;
+    stats.predicate_calls += scanned_postings;
+
+    const size_t scored_document_count = document_to_relevance.size();
+    for (const QueryTerm& term : plan.minus_terms) {
+        for (const auto& [document_id, _] : *term.postings) {
             document_to_relevance.erase(document_id);
         }
+        stats.scanned_postings += term.postings->size();
     }
+    stats.scored_documents += scored_document_count;
+    stats.excluded_documents += scored_document_count - document_to_relevance.size();
+    // узлы словаря, вклады слов и результат
+    stats.allocations += scored_document_count + 2;
 
     std::vector<Document> matched_documents;
-    for (auto [document_id, relevance] : document_to_relevance) {
+    matched_documents.reserve(document_to_relevance.size());
+    for (const auto [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
     }
     return matched_documents;
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    const auto query = ParseQuery(raw_query);
+void SearchServer::FindAllDocuments(ThreadPool& pool, std::string_view raw_query, DocumentPredicate document_predicate,
+    std::vector<Document>& matched_documents, QueryStats& stats) const {
+    const QueryPlan plan = PlanQuery(raw_query, stats);
+
+    PoolQueryScratch& thread_scratch = GetThreadPoolQueryScratch();
+    PoolQueryScratch nested_scratch;
+    PoolQueryScratch& scratch = thread_scratch.is_busy ? nested_scratch : thread_scratch;
+    struct ScratchLease {
+        PoolQueryScratch& scratch;
+        ~ScratchLease() {
+            scratch.is_busy = false;
+        }
+    } lease{ scratch };
+    scratch.is_busy = true;
+
+    // Каждый исполнитель дописывает вклады в свой вектор, блокировки не нужны
+    std::vector<std::vector<std::pair<int, double>>>& worker_contributions = scratch.worker_contributions;
+    worker_contributions.resize(pool.GetThreadCount() + 1);
+    scratch.worker_capacities.clear();
+    for (std::vector<std::pair<int, double>>& contributions : worker_contributions) {
+        contributions.clear();
+        scratch.worker_capacities.push_back(contributions.capacity());
+    }
+
+    VisitScoringModel(scoring_model_, plan.corpus, [&](const auto& scoring) {
+        pool.ParallelFor(plan.plus_terms.size(),
+            [this, &pool, &plan, &scoring, &document_predicate, &worker_contributions](size_t index) {
+                const QueryTerm& term = plan.plus_terms[index];
+                auto& contributions = worker_contributions[pool.GetCurrentWorkerIndex()];
+                for (const auto& [document_id, count] : *term.postings) {
+                    const auto& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        contributions.emplace_back(document_id, scoring.ComputeTermWeight(count, document_data.norm) * term.inverse_document_freq);
+                    }
+                }
+        });
+    });
+
+    for (const QueryTerm& term : plan.plus_terms) {
+        stats.scanned_postings += term.postings->size();
+        stats.predicate_calls += term.postings->size();
+    }
+
+    std::vector<std::pair<int, double>>& contributions = scratch.contributions;
+    contributions.clear();
+    const size_t contributions_capacity = contributions.capacity();
+    for (size_t i = 0; i < worker_contributions.size(); ++i) {
+        contributions.insert(contributions.end(), worker_contributions[i].begin(), worker_contributions[i].end());
+        stats.allocations += CountResultAllocations(scratch.worker_capacities[i], worker_contributions[i].size());
+    }
+    stats.allocations += contributions.capacity() != contributions_capacity;
 
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    // Вклады документа складываются по возрастанию, поэтому релевантность
+    // не зависит от того, какой исполнитель обработал слово
+    std::sort(contributions.begin(), contributions.end());
+    size_t document_count = 0;
+    for (const auto& [document_id, contribution] : contributions) {
+        if (document_count > 0 && contributions[document_count - 1].first == document_id) {
+            contributions[document_count - 1].second += contribution;
+        }
+        else {
+            contributions[document_count++] = { document_id, contribution };
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
+    }
+    contributions.resize(document_count);
+
+    // Документы и списки минус-слов упорядочены по id, поэтому исключение — слияние
+    const size_t scored_document_count = contributions.size();
+    for (const QueryTerm& term : plan.minus_terms) {
+        auto excluded_it = term.postings->begin();
+        size_t kept_count = 0;
+        for (const auto& [document_id, relevance] : contributions) {
+            while (excluded_it != term.postings->end() && excluded_it->first < document_id) {
+                ++excluded_it;
+            }
+            if (excluded_it == term.postings->end() || excluded_it->first != document_id) {
+                contributions[kept_count++] = { document_id, relevance };
+            }
+        }
+        contributions.resize(kept_count);
+        stats.scanned_postings += term.postings->size();
+    }
+    stats.scored_documents += scored_document_count;
+    stats.excluded_documents += scored_document_count - contributions.size();
+    stats.allocations += matched_documents.capacity() < contributions.size();
+
+    matched_documents.clear();
+    matched_documents.reserve(contributions.size());
+    for (const auto& [document_id, relevance] : contributions) {
+        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    }
+}
+
+template<typename DocumentPredicate>
+void SearchServer::ExecuteQueryPlan(const QueryPlan& plan, DocumentPredicate document_predicate, std::vector<Document>& matched_documents, QueryStats& stats) const {
+    matched_documents.clear();
+    VisitScoringModel(scoring_model_, plan.corpus, [&](const auto& scoring) {
+        if (plan.strategy == QueryStrategy::TERM_AT_A_TIME) {
+            FindAllDocumentsTermAtATime(plan, scoring, document_predicate, matched_documents, stats);
+        }
+        else {
+            FindAllDocumentsDocumentAtATime(plan, scoring, document_predicate, matched_documents, stats);
+        }
+    });
+}
+
+template<typename Scoring, typename DocumentPredicate>
+void SearchServer::FindAllDocumentsTermAtATime(const QueryPlan& plan, const Scoring& scoring, DocumentPredicate document_predicate,
+    std::vector<Document>& matched_documents, QueryStats& stats) const {
+    std::map<int, double> document_to_relevance;
+
+    // Записи слова, прошедшие фильтр, собираются в плоские массивы, веса считаются одним циклом
+    // AccumulateTermScores и затем прибавляются к релевантности своих документов
+    std::vector<uint32_t> counts;
+    std::vector<double> norms;
+    std::vector<double> weights;
+    std::vector<double*> relevances;
+    for (const QueryTerm& term : plan.plus_terms) {
+        counts.clear();
+        norms.clear();
+        relevances.clear();
+        for (const auto& [document_id, count] : *term.postings) {
             const auto& document_data = documents_.at(document_id);
             if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                counts.push_back(count);
+                norms.push_back(document_data.norm);
+                relevances.push_back(&document_to_relevance[document_id]);
             }
         }
+        weights.assign(counts.size(), 0.0);
+        AccumulateTermScores(scoring, term.inverse_document_freq, counts.data(), norms.data(), counts.size(), weights.data());
+        for (size_t i = 0; i < relevances.size(); ++i) {
+            *relevances[i] += weights[i];
+        }
+        stats.scanned_postings += term.postings->size();
+        stats.predicate_calls += term.postings->size();
     }
 
-    for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
+    const size_t scored_document_count = document_to_relevance.size();
+    for (const QueryTerm& term : plan.minus_terms) {
+        for (const auto& [document_id, _] : *term.postings) {
             document_to_relevance.erase(document_id);
         }
+        stats.scanned_postings += term.postings->size();
     }
+    stats.scored_documents += scored_document_count;
+    stats.excluded_documents += scored_document_count - document_to_relevance.size();
+    // узлы словаря, плоские массивы слова и результат
+    stats.allocations += scored_document_count + 4 + (matched_documents.capacity() < document_to_relevance.size());
 
-    std::vector<Document> matched_documents;
+    matched_documents.reserve(document_to_relevance.size());
     for (const auto [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
     }
-    return matched_documents;
 }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(16);
-    const auto query = ParseQuery(raw_query);
-
-    std::for_each(policy,
-        query.minus_words.begin(), query.minus_words.end(),
-        [this, &document_to_relevance](std::string_view word) {
-            if (word_to_document_freqs_.count(word)) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.Erase(document_id);
+template<typename Scoring, typename DocumentPredicate>
+void SearchServer::FindAllDocumentsDocumentAtATime(const QueryPlan& plan, const Scoring& scoring, DocumentPredicate document_predicate,
+    std::vector<Document>& matched_documents, QueryStats& stats) const {
+    using PostingIterator = Postings::const_iterator;
+
+    // Куча (id документа, номер слова): документы извлекаются по возрастанию id,
+    // а вклады слов в один документ — в порядке плана, как при пословной обработке
+    std::vector<PostingIterator> plus_iterators;
+    plus_iterators.reserve(plan.plus_terms.size());
+    std::vector<std::pair<int, size_t>> heap;
+    heap.reserve(plan.plus_terms.size());
+    for (size_t i = 0; i < plan.plus_terms.size(); ++i) {
+        plus_iterators.push_back(plan.plus_terms[i].postings->begin());
+        heap.emplace_back(plus_iterators[i]->first, i);
+        stats.scanned_postings += plan.plus_terms[i].postings->size();
+    }
+    std::make_heap(heap.begin(), heap.end(), std::greater<>());
+
+    std::vector<PostingIterator> minus_iterators;
+    minus_iterators.reserve(plan.minus_terms.size());
+    for (const QueryTerm& term : plan.minus_terms) {
+        minus_iterators.push_back(term.postings->begin());
+    }
+
+    const auto is_excluded = [this, &plan, &minus_iterators, &stats](int document_id) {
+        for (size_t i = 0; i < plan.minus_terms.size(); ++i) {
+            const auto& postings = *plan.minus_terms[i].postings;
+            if (plan.strategy == QueryStrategy::INTERSECTION) {
+                ++stats.scanned_postings;
+                if (postings.count(document_id) > 0) {
+                    return true;
                 }
+                continue;
             }
-    });
+            auto& it = minus_iterators[i];
+            while (it != postings.end() && it->first < document_id) {
+                ++it;
+                ++stats.scanned_postings;
+            }
+            if (it != postings.end() && it->first == document_id) {
+                return true;
+            }
+        }
+        return false;
+    };
 
-    std::for_each(policy,
-        query.plus_words.begin(), query.plus_words.end(),
-        [this, &document_predicate, &document_to_relevance](std::string_view word) {
-            if (word_to_document_freqs_.count(word)) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
+    // Принятые документы копятся блоками: число вхождений каждого слова плана (ноль, если слова
+    // в документе нет) и нормировка. Релевантность блока считается по словам в порядке плана
+    // циклом AccumulateTermScores. Нулевой вес отсутствующего слова сумму не меняет,
+    // поэтому релевантность совпадает с пословной обработкой
+    const size_t term_count = plan.plus_terms.size();
+    std::vector<uint32_t> block_counts(term_count * DOCUMENT_BLOCK_SIZE);
+    std::vector<double> block_norms;
+    block_norms.reserve(DOCUMENT_BLOCK_SIZE);
+    std::vector<double> block_relevances;
+    block_relevances.reserve(DOCUMENT_BLOCK_SIZE);
+    std::vector<std::pair<int, int>> block_documents;
+    block_documents.reserve(DOCUMENT_BLOCK_SIZE);
+    std::vector<uint32_t> document_counts(term_count);
+    const auto score_block = [&] {
+        const size_t block_size = block_documents.size();
+        block_relevances.assign(block_size, 0.0);
+        for (size_t i = 0; i < term_count; ++i) {
+            AccumulateTermScores(scoring, plan.plus_terms[i].inverse_document_freq, block_counts.data() + i * DOCUMENT_BLOCK_SIZE,
+                block_norms.data(), block_size, block_relevances.data());
+        }
+        for (size_t j = 0; j < block_size; ++j) {
+            matched_documents.push_back({ block_documents[j].first, block_relevances[j], block_documents[j].second });
+        }
+        block_documents.clear();
+        block_norms.clear();
+    };
+
+    const size_t initial_capacity = matched_documents.capacity();
+    size_t candidate_count = 0;
+    size_t excluded_count = 0;
+    while (!heap.empty()) {
+        const int document_id = heap.front().first;
+        const auto& document_data = documents_.at(document_id);
+        std::fill(document_counts.begin(), document_counts.end(), 0);
+        while (!heap.empty() && heap.front().first == document_id) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            const size_t term_index = heap.back().second;
+            heap.pop_back();
+
+            auto& it = plus_iterators[term_index];
+            document_counts[term_index] = it->second;
+            if (++it != plan.plus_terms[term_index].postings->end()) {
+                heap.emplace_back(it->first, term_index);
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+            }
+        }
+
+        ++candidate_count;
+        if (document_predicate(document_id, document_data.status, document_data.rating)) {
+            if (is_excluded(document_id)) {
+                ++excluded_count;
+            }
+            else {
+                const size_t block_index = block_documents.size();
+                for (size_t i = 0; i < term_count; ++i) {
+                    block_counts[i * DOCUMENT_BLOCK_SIZE + block_index] = document_counts[i];
+                }
+                block_norms.push_back(document_data.norm);
+                block_documents.emplace_back(document_id, document_data.rating);
+                if (block_documents.size() == DOCUMENT_BLOCK_SIZE) {
+                    score_block();
                 }
             }
-    });
+        }
+    }
+    score_block();
 
-    std::map<int, double> document_to_relevance_reduced = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(document_to_relevance_reduced.size());
+    stats.predicate_calls += candidate_count;
+    stats.scored_documents += candidate_count;
+    stats.excluded_documents += excluded_count;
+    // куча, итераторы плюс- и минус-слов, массивы блока и результат, растущий удвоением
+    stats.allocations += 8 + CountResultAllocations(initial_capacity, matched_documents.size());
+}
 
-    for (const auto [document_id, relevance] : document_to_relevance_reduced) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template<typename DocumentPredicate>
+void SearchServer::FindTopDocumentsByImpact(const QueryPlan& plan, DocumentPredicate document_predicate, size_t top_count,
+    SearchResultBuffer& buffer, QueryStats& stats) const {
+    using ImpactState = SearchResultBuffer::ImpactState;
+    // Проверка остановки проходит по всем затронутым документам, поэтому между проверками
+    // просматривается не меньше записей, чем затронуто документов
+    static constexpr size_t MIN_CHECK_PERIOD = 256;
+
+    const ImpactIndex& index = *impact_index_;
+    buffer.matched_documents_.clear();
+    buffer.touched_documents_.clear();
+    if (top_count == 0 || plan.plus_terms.empty()) {
+        return;
     }
-    return matched_documents;
+    if (buffer.impact_accumulators_.size() < index.documents.size()) {
+        buffer.impact_accumulators_.resize(index.documents.size());
+    }
+
+    // Куча (вклад очередного отрезка, номер слова в плане): отрезки всех слов идут по убыванию вклада.
+    // remaining_impact — сумма вкладов очередных отрезков, больше неё непросмотренные записи документу не добавят
+    std::vector<std::pair<uint16_t, size_t>> heap;
+    heap.reserve(plan.plus_terms.size());
+    std::vector<size_t> next_segments(plan.plus_terms.size(), 0);
+    uint64_t remaining_impact = 0;
+    size_t total_postings = 0;
+    for (size_t i = 0; i < plan.plus_terms.size(); ++i) {
+        const ImpactPostings& postings = index.terms[plan.plus_terms[i].term_id];
+        heap.emplace_back(postings.segments.front().impact, i);
+        remaining_impact += postings.segments.front().impact;
+        total_postings += postings.documents.size();
+    }
+    std::make_heap(heap.begin(), heap.end());
+
+    const auto is_excluded = [&plan, &stats](int document_id) {
+        for (const QueryTerm& term : plan.minus_terms) {
+            ++stats.scanned_postings;
+            if (term.postings->count(document_id) > 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    size_t scanned_postings = 0;
+    size_t next_check = MIN_CHECK_PERIOD;
+    size_t excluded_count = 0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end());
+        const auto [impact, term_index] = heap.back();
+        heap.pop_back();
+
+        const ImpactPostings& postings = index.terms[plan.plus_terms[term_index].term_id];
+        size_t& segment = next_segments[term_index];
+        const uint32_t first = segment == 0 ? 0 : postings.segments[segment - 1].end;
+        const uint32_t last = postings.segments[segment].end;
+        for (uint32_t i = first; i < last; ++i) {
+            const uint32_t document_index = postings.documents[i];
+            SearchResultBuffer::ImpactAccumulator& accumulator = buffer.impact_accumulators_[document_index];
+            if (accumulator.state == ImpactState::UNSEEN) {
+                buffer.touched_documents_.push_back(document_index);
+                const ImpactDocument& document = index.documents[document_index];
+                if (!document_predicate(document.id, document.status, document.rating)) {
+                    accumulator.state = ImpactState::REJECTED;
+                }
+                else if (is_excluded(document.id)) {
+                    accumulator.state = ImpactState::EXCLUDED;
+                    ++excluded_count;
+                }
+                else {
+                    accumulator.state = ImpactState::ADMISSIBLE;
+                }
+            }
+            if (accumulator.state == ImpactState::ADMISSIBLE) {
+                accumulator.impact_sum += impact;
+                ++accumulator.term_count;
+            }
+        }
+        scanned_postings += last - first;
+
+        remaining_impact -= impact;
+        if (++segment < postings.segments.size()) {
+            heap.emplace_back(postings.segments[segment].impact, term_index);
+            std::push_heap(heap.begin(), heap.end());
+            remaining_impact += postings.segments[segment].impact;
+        }
+
+        // Когда все записи просмотрены, отбор всегда успешен
+        if (heap.empty() || scanned_postings >= next_check) {
+            if (SelectImpactCandidates(top_count, remaining_impact, buffer)) {
+                break;
+            }
+            next_check = scanned_postings + std::max(MIN_CHECK_PERIOD, buffer.touched_documents_.size());
+        }
+    }
+
+    stats.scanned_postings += scanned_postings;
+    stats.skipped_postings += total_postings - scanned_postings;
+    stats.predicate_calls += buffer.touched_documents_.size();
+    stats.excluded_documents += excluded_count;
+
+    ScoreImpactCandidates(plan, buffer);
+    stats.scored_documents += buffer.matched_documents_.size();
+    // куча и позиции слов; накопители и результаты живут в буфере
+    stats.allocations += 2;
 }
 
+template <typename ExecutionPolicy, typename DocumentIds>
+MatchedDocuments SearchServer::MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const DocumentIds& document_ids) const {
+    static constexpr size_t MAX_MATCHED_WORDS = 64;
+
+    Query query = ParseQuery(raw_query);
+    if (query.plus_words.size() > MAX_MATCHED_WORDS) {
+        throw std::invalid_argument("в запросе больше 64 плюс-слов"s);
+    }
+
+    MatchedDocuments result;
+    result.plus_words = std::move(query.plus_words);
+
+    // Слова, которых нет в словаре, не встретятся ни в одном документе
+    const std::vector<std::pair<uint32_t, uint64_t>> plus_terms = MakeSortedTerms(result.plus_words);
+    const std::vector<std::pair<uint32_t, uint64_t>> minus_terms = MakeSortedTerms(query.minus_words);
+
+    const std::vector<int> ids(std::begin(document_ids), std::end(document_ids));
+    for (const int document_id : ids) {
+        if (documents_.count(document_id) == 0) {
+            throw std::out_of_range("document_id out of range"s);
+        }
+    }
+    result.matches.resize(ids.size());
+
+    const auto match_document = [this, &plus_terms, &minus_terms](int document_id) {
+        const DocumentData& document = documents_.at(document_id);
+        DocumentMatch match{ document_id, document.status, 0 };
+        if (MatchSortedTerms(document, minus_terms) == 0) {
+            match.matched_words = MatchSortedTerms(document, plus_terms);
+        }
+        return match;
+    };
+
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPool>) {
+        policy.ParallelFor(ids.size(), [&ids, &result, &match_document](size_t index) {
+            result.matches[index] = match_document(ids[index]);
+        });
+    }
+    else {
+        std::transform(policy, ids.begin(), ids.end(), result.matches.begin(), match_document);
+    }
+
+    return result;
+}
 
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (document_to_word_freqs_.count(document_id)) {
-        const std::map<std::string_view, double>& word_freqs = document_to_word_freqs_.at(document_id);
-        std::vector<std::string*> words(word_freqs.size());
-
-        std::transform(policy,
-            word_freqs.begin(), word_freqs.end(),
-            words.begin(),
-            [](const auto& item) { return &item.first; }
-        );
+    if (documents_.count(document_id)) {
+        const std::vector<Postings*> postings = DetachDocumentWords(document_id);
 
         std::for_each(policy,
-            words.begin(), words.end(), 
-            [this, document_id](std::string* item) {
-                word_to_document_freqs_.at(*item).erase(document_id);
+            postings.begin(), postings.end(),
+            [document_id](Postings* word_postings) {
+                word_postings->erase(document_id);
         });
 
-        document_to_word_freqs_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+        EraseDocument(document_id);
+    }
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, std::vector<PreparedDocument> documents) {
+    Addition addition = PrepareAddition(documents);
+    std::vector<WordAddition>& additions = addition.words;
+
+    // Документы добавляются по возрастанию id, поэтому новые записи обычно дописываются в конец списка
+    const auto add_to_word = [](WordAddition& addition) {
+        for (const auto& [document_id, count] : addition.document_counts) {
+            addition.postings->emplace(document_id, count);
+        }
+    };
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPool>) {
+        policy.ParallelFor(additions.size(), [&additions, &add_to_word](size_t index) {
+            add_to_word(additions[index]);
+        });
     }
+    else {
+        std::for_each(policy, additions.begin(), additions.end(), add_to_word);
+    }
+
+    FinishAddition(documents, addition.documents);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids) {
+    std::vector<int> removed_ids = document_ids;
+    std::vector<WordRemoval> removals = PrepareRemoval(removed_ids);
+
+    // Списки документов разных слов независимы, их можно перестраивать параллельно
+    const auto remove_from_word = [](WordRemoval& removal) {
+        if (!removal.is_word_released) {
+            RemoveFromPostings(*removal.postings, removal.document_ids);
+        }
+    };
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPool>) {
+        policy.ParallelFor(removals.size(), [&removals, &remove_from_word](size_t index) {
+            remove_from_word(removals[index]);
+        });
+    }
+    else {
+        std::for_each(policy, removals.begin(), removals.end(), remove_from_word);
+    }
+
+    FinishRemoval(removed_ids, removals);
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "sharded_search_server.h"
+#include "hash_utils.h"
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    SearchServer& shard = shards_[GetShardIndex(document_id)];
+    shard.AddDocument(document_id, document, status, ratings);
+
+    const WordFrequenciesView word_freqs = shard.GetWordFrequencies(document_id);
+    ++statistics_.document_count;
+    statistics_.word_count += word_freqs.GetWordCount();
+    for (const auto& [word, _] : word_freqs) {
+        const auto it = statistics_.document_freqs.find(word);
+        if (it == statistics_.document_freqs.end()) {
+            statistics_.document_freqs.emplace(word, 1);
+        }
+        else {
+            ++it->second;
+        }
+    }
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    SearchServer& shard = shards_[GetShardIndex(document_id)];
+    const int shard_document_count = shard.GetDocumentCount();
+
+    // Слова документа берутся из словаря шарда, поэтому статистика обновляется до удаления.
+    // Документ из одних стоп-слов не имеет слов, его наличие видно только по числу документов
+    const WordFrequenciesView word_freqs = shard.GetWordFrequencies(document_id);
+    statistics_.word_count -= word_freqs.GetWordCount();
+    for (const auto& [word, _] : word_freqs) {
+        const auto it = statistics_.document_freqs.find(word);
+        if (--it->second == 0) {
+            statistics_.document_freqs.erase(it);
+        }
+    }
+    shard.RemoveDocument(document_id);
+    statistics_.document_count -= shard_document_count - shard.GetDocumentCount();
+}
+
+void ShardedSearchServer::SetSoftStopWordRatio(std::optional<double> ratio) {
+    for (SearchServer& shard : shards_) {
+        shard.SetSoftStopWordRatio(ratio);
+    }
+}
+
+void ShardedSearchServer::SetMaxPrefixExpansions(size_t max_count) noexcept {
+    for (SearchServer& shard : shards_) {
+        shard.SetMaxPrefixExpansions(max_count);
+    }
+}
+
+void ShardedSearchServer::SetFuzzySearch(std::optional<FuzzySearchOptions> options) {
+    for (SearchServer& shard : shards_) {
+        shard.SetFuzzySearch(options);
+    }
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    return statistics_.document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return shards_.at(index);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // std::hash<int> не меняет id, и при id с общим шагом часть шардов осталась бы пустой
+    return MixHash(static_cast<uint32_t>(document_id)) % shards_.size();
+}
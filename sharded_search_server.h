@@ -0,0 +1,149 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Поисковый сервер, документы которого распределены между несколькими серверами (шардами)
+ * по хешу id.
+ *
+ * Шарды считают IDF и среднюю длину документа по общей статистике корпуса, поэтому релевантность документов
+ * совпадает с релевантностью на одном сервере. Запрос выполняется всеми шардами
+ * параллельно, лучшие документы шардов объединяются в общий результат.
+ *
+ * Пример использования:
+ *
+ *  ShardedSearchServer search_server("and with"s, 4);
+ *  search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+ *  search_server.FindTopDocuments("cat"s);
+ */
+class ShardedSearchServer {
+public:
+    template <typename StopWords>
+    ShardedSearchServer(const StopWords& stop_words, size_t shard_count, ScoringModel scoring_model = ScoringModel::TF_IDF);
+
+    // Шарды ссылаются на статистику корпуса, поэтому сервер не копируется и не перемещается
+    ShardedSearchServer(const ShardedSearchServer&) = delete;
+    ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Политика выполнения задаёт обход шардов, каждый шард выполняет запрос последовательно.
+    // Без политики шарды обходятся последовательно, как в SearchServer
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    template <typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const;
+
+    void RemoveDocument(int document_id);
+
+    // Задаёт долю документов мягких стоп-слов всем шардам. Доля считается по всему корпусу
+    void SetSoftStopWordRatio(std::optional<double> ratio);
+
+    // Задаёт число слов, подставляемых вместо префикса, всем шардам. Каждый шард раскрывает префикс
+    // по своему словарю, поэтому при превышении предела шарды могут выбрать разные слова
+    void SetMaxPrefixExpansions(size_t max_count) noexcept;
+
+    // Включает поиск с опечатками во всех шардах. Близкие слова ищутся в словаре шарда,
+    // а их вес и число документов берутся по всему корпусу
+    void SetFuzzySearch(std::optional<FuzzySearchOptions> options);
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+    const SearchServer& GetShard(size_t index) const;
+
+private:
+    CorpusStatistics statistics_;
+    std::vector<SearchServer> shards_;
+
+    size_t GetShardIndex(int document_id) const;
+};
+
+template <typename StopWords>
+ShardedSearchServer::ShardedSearchServer(const StopWords& stop_words, size_t shard_count, ScoringModel scoring_model) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("число шардов должно быть положительным"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words, scoring_model);
+        shards_.back().SetCorpusStatistics(&statistics_);
+    }
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    const auto find_in_shard = [&](size_t index) {
+        shard_documents[index] = shards_[index].FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    };
+
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, ThreadPool>) {
+        policy.ParallelFor(shards_.size(), find_in_shard);
+    }
+    else {
+        std::vector<size_t> indexes(shards_.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(policy, indexes.begin(), indexes.end(), find_in_shard);
+    }
+
+    // Каждый шард вернул свои лучшие документы, среди них есть и лучшие документы корпуса
+    std::vector<Document> matched_documents;
+    for (const std::vector<Document>& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    std::sort(matched_documents.begin(), matched_documents.end(), SearchServer::IsMoreRelevant);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(policy, raw_query,
+        [status](int document_id, DocumentStatus document_status, int rating) {
+            return document_status == status;
+    });
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename ExecutionPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(policy, raw_query, document_id);
+}
@@ -0,0 +1,449 @@
+#pragma once
+
+#include "memory_accounting.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * Упорядоченный словарь, копии которого разделяют неизменённые блоки записей.
+ *
+ * Записи лежат по возрастанию ключей в блоках не больше MAX_BLOCK_SIZE записей, а словарь хранит
+ * указатели на блоки и первые ключи блоков. Копия словаря копирует только их. Блок, который
+ * разделяют несколько копий, копируется перед изменением (копирование при записи), поэтому изменение
+ * копии обходится в число блоков и размер изменённых блоков, а не в размер словаря.
+ * Копии можно читать из разных потоков, пока их не изменяют.
+ *
+ * Compare должен сравнивать ключи с типами, по которым ищут записи (например, std::less<>).
+ *
+ * Пример использования:
+ *
+ *  SharedSortedMap<int, double> weights{ allocator };
+ *  weights.emplace(1, 0.5);
+ *  SharedSortedMap<int, double> copy = weights; // блоки общие
+ *  copy.emplace(2, 0.25);                       // копируется один блок
+ */
+template <typename Key, typename Value, typename Compare = std::less<>>
+class SharedSortedMap {
+private:
+    struct Block;
+    using BlockPointers = std::vector<std::shared_ptr<Block>, CountingAllocator<std::shared_ptr<Block>>>;
+
+public:
+    using value_type = std::pair<Key, Value>;
+
+    static constexpr size_t MAX_BLOCK_SIZE = 128;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = SharedSortedMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator() = default;
+
+        reference operator*() const noexcept {
+            return *entry_;
+        }
+
+        pointer operator->() const noexcept {
+            return entry_;
+        }
+
+        const_iterator& operator++() noexcept {
+            // пустых блоков нет, поэтому за последней записью блока идёт начало следующего
+            if (++entry_ == block_end_) {
+                SetBlock(block_ + 1, 0);
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) noexcept {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator& other) const noexcept {
+            return entry_ == other.entry_;
+        }
+
+        bool operator!=(const const_iterator& other) const noexcept {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        friend class SharedSortedMap;
+
+        const_iterator(const BlockPointers* blocks, size_t block, size_t position) noexcept
+            : blocks_(blocks)
+        {
+            SetBlock(block, position);
+        }
+
+        // У итератора за последней записью entry_ равен nullptr
+        void SetBlock(size_t block, size_t position) noexcept {
+            block_ = block;
+            if (block_ < blocks_->size()) {
+                const auto& entries = (*blocks_)[block_]->entries;
+                entry_ = entries.data() + position;
+                block_end_ = entries.data() + entries.size();
+            }
+            else {
+                entry_ = nullptr;
+                block_end_ = nullptr;
+            }
+        }
+
+        const BlockPointers* blocks_ = nullptr;
+        size_t block_ = 0;
+        const value_type* entry_ = nullptr;
+        const value_type* block_end_ = nullptr;
+    };
+
+    // Обходит ключи словаря по возрастанию
+    class const_key_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Key;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Key*;
+        using reference = const Key&;
+
+        const_key_iterator() = default;
+
+        explicit const_key_iterator(const_iterator it) noexcept
+            : it_(it)
+        {
+        }
+
+        reference operator*() const {
+            return it_->first;
+        }
+
+        pointer operator->() const {
+            return &it_->first;
+        }
+
+        const_key_iterator& operator++() {
+            ++it_;
+            return *this;
+        }
+
+        const_key_iterator operator++(int) {
+            const_key_iterator previous = *this;
+            ++it_;
+            return previous;
+        }
+
+        bool operator==(const const_key_iterator& other) const noexcept {
+            return it_ == other.it_;
+        }
+
+        bool operator!=(const const_key_iterator& other) const noexcept {
+            return it_ != other.it_;
+        }
+
+    private:
+        const_iterator it_;
+    };
+
+    explicit SharedSortedMap(const CountingAllocator<char>& allocator)
+        : allocator_(allocator)
+        , blocks_(allocator)
+        , first_keys_(allocator)
+    {
+    }
+
+    const CountingAllocator<char>& get_allocator() const noexcept {
+        return allocator_;
+    }
+
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(&blocks_, 0, 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(&blocks_, blocks_.size(), 0);
+    }
+
+    const_key_iterator key_begin() const noexcept {
+        return const_key_iterator(begin());
+    }
+
+    const_key_iterator key_end() const noexcept {
+        return const_key_iterator(end());
+    }
+
+    // Первая запись с ключом не меньше key
+    template <typename K>
+    const_iterator lower_bound(const K& key) const {
+        if (blocks_.empty()) {
+            return end();
+        }
+        const size_t block = FindBlock(key);
+        const size_t position = FindPosition(*blocks_[block], key);
+        if (position == blocks_[block]->entries.size()) {
+            return const_iterator(&blocks_, block + 1, 0);
+        }
+        return const_iterator(&blocks_, block, position);
+    }
+
+    template <typename K>
+    const_iterator find(const K& key) const {
+        const const_iterator it = lower_bound(key);
+        return it != end() && !compare_(key, it->first) ? it : end();
+    }
+
+    template <typename K>
+    size_t count(const K& key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    template <typename K>
+    const Value& at(const K& key) const {
+        const const_iterator it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("ключа нет в словаре");
+        }
+        return it->second;
+    }
+
+    // Добавляет запись, если ключа ещё нет в словаре. Возвращает, добавлена ли запись
+    template <typename K, typename V>
+    bool emplace(K&& key, V&& value) {
+        if (blocks_.empty()) {
+            blocks_.push_back(MakeBlock());
+            blocks_.back()->entries.emplace_back(std::forward<K>(key), std::forward<V>(value));
+            first_keys_.push_back(blocks_.back()->entries.front().first);
+            ++size_;
+            return true;
+        }
+
+        size_t block = FindBlock(key);
+        size_t position = FindPosition(*blocks_[block], key);
+        if (position < blocks_[block]->entries.size() && !compare_(key, blocks_[block]->entries[position].first)) {
+            return false;
+        }
+
+        if (blocks_[block]->entries.size() >= MAX_BLOCK_SIZE) {
+            // Ключи, которые идут по возрастанию, начинают новый блок, поэтому полные блоки не делятся пополам
+            if (block + 1 == blocks_.size() && position == blocks_[block]->entries.size()) {
+                blocks_.push_back(MakeBlock());
+                blocks_.back()->entries.emplace_back(std::forward<K>(key), std::forward<V>(value));
+                first_keys_.push_back(blocks_.back()->entries.front().first);
+                ++size_;
+                return true;
+            }
+            const size_t lower_size = SplitBlock(block);
+            if (position > lower_size) {
+                ++block;
+                position -= lower_size;
+            }
+        }
+
+        Block& target = GetMutableBlock(block);
+        target.entries.emplace(target.entries.begin() + position, std::forward<K>(key), std::forward<V>(value));
+        if (position == 0) {
+            first_keys_[block] = target.entries.front().first;
+        }
+        ++size_;
+        return true;
+    }
+
+    template <typename K>
+    size_t erase(const K& key) {
+        if (blocks_.empty()) {
+            return 0;
+        }
+        const size_t block = FindBlock(key);
+        const size_t position = FindPosition(*blocks_[block], key);
+        if (position == blocks_[block]->entries.size() || compare_(key, blocks_[block]->entries[position].first)) {
+            return 0;
+        }
+
+        Block& target = GetMutableBlock(block);
+        target.entries.erase(target.entries.begin() + position);
+        --size_;
+        if (target.entries.empty()) {
+            blocks_.erase(blocks_.begin() + block);
+            first_keys_.erase(first_keys_.begin() + block);
+            return 1;
+        }
+        if (position == 0) {
+            first_keys_[block] = target.entries.front().first;
+        }
+        MergeSmallBlocks(block);
+        return 1;
+    }
+
+private:
+    struct Block {
+        explicit Block(const CountingAllocator<char>& allocator)
+            : entries(allocator)
+        {
+        }
+
+        std::vector<value_type, CountingAllocator<value_type>> entries;
+    };
+
+    CountingAllocator<char> allocator_;
+    Compare compare_;
+    // блоки не бывают пустыми
+    BlockPointers blocks_;
+    // первые ключи блоков: блок ищется по ним без обращения к самим блокам
+    std::vector<Key, CountingAllocator<Key>> first_keys_;
+    size_t size_ = 0;
+
+    std::shared_ptr<Block> MakeBlock() const {
+        return std::allocate_shared<Block>(allocator_, allocator_);
+    }
+
+    // Последний блок, первый ключ которого не больше key, или первый блок. Словарь не пуст
+    template <typename K>
+    size_t FindBlock(const K& key) const {
+        const auto it = std::upper_bound(first_keys_.begin(), first_keys_.end(), key,
+            [this](const K& lhs, const Key& rhs) {
+                return compare_(lhs, rhs);
+        });
+        return it == first_keys_.begin() ? 0 : static_cast<size_t>(it - first_keys_.begin()) - 1;
+    }
+
+    template <typename K>
+    size_t FindPosition(const Block& block, const K& key) const {
+        const auto it = std::lower_bound(block.entries.begin(), block.entries.end(), key,
+            [this](const value_type& lhs, const K& rhs) {
+                return compare_(lhs.first, rhs);
+        });
+        return static_cast<size_t>(it - block.entries.begin());
+    }
+
+    // Возвращает блок, который можно менять, не затрагивая копии словаря
+    Block& GetMutableBlock(size_t index) {
+        std::shared_ptr<Block>& block = blocks_[index];
+        if (block.use_count() > 1) {
+            block = std::allocate_shared<Block>(allocator_, *block);
+        }
+        return *block;
+    }
+
+    // Переносит вторую половину блока в новый блок после него. Возвращает размер первой половины
+    size_t SplitBlock(size_t index) {
+        Block& lower = GetMutableBlock(index);
+        const size_t lower_size = lower.entries.size() / 2;
+        std::shared_ptr<Block> upper = MakeBlock();
+        upper->entries.reserve(lower.entries.size() - lower_size);
+        std::move(lower.entries.begin() + lower_size, lower.entries.end(), std::back_inserter(upper->entries));
+        lower.entries.erase(lower.entries.begin() + lower_size, lower.entries.end());
+        first_keys_.insert(first_keys_.begin() + index + 1, upper->entries.front().first);
+        blocks_.insert(blocks_.begin() + index + 1, std::move(upper));
+        return lower_size;
+    }
+
+    // Блок объединяется с соседом, если вместе они заполнены не больше чем наполовину,
+    // чтобы после удалений блоков не становилось слишком много
+    void MergeSmallBlocks(size_t index) {
+        if (index > 0 && blocks_[index - 1]->entries.size() + blocks_[index]->entries.size() <= MAX_BLOCK_SIZE / 2) {
+            --index;
+        }
+        else if (index + 1 == blocks_.size() || blocks_[index]->entries.size() + blocks_[index + 1]->entries.size() > MAX_BLOCK_SIZE / 2) {
+            return;
+        }
+        // Следующий блок может быть общим с копиями, поэтому его записи копируются
+        const std::shared_ptr<Block> next = blocks_[index + 1];
+        Block& target = GetMutableBlock(index);
+        target.entries.insert(target.entries.end(), next->entries.begin(), next->entries.end());
+        blocks_.erase(blocks_.begin() + index + 1);
+        first_keys_.erase(first_keys_.begin() + index + 1);
+    }
+};
+
+/**
+ * Вектор, копии которого разделяют неизменённые части.
+ *
+ * Элементы лежат в частях по CHUNK_SIZE элементов, вектор хранит указатели на части.
+ * Общая часть копируется перед изменением, как в SharedSortedMap. Элементы не перемещаются
+ * при добавлении новых, но ссылка на элемент, полученная через operator[], может устареть после
+ * GetMutable того же элемента, если его часть была общей.
+ */
+template <typename T>
+class SharedChunkedVector {
+public:
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    explicit SharedChunkedVector(const CountingAllocator<char>& allocator)
+        : allocator_(allocator)
+        , chunks_(allocator)
+    {
+    }
+
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    const T& operator[](size_t index) const {
+        return (*chunks_[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    }
+
+    // Элемент, который можно менять, не затрагивая копии вектора
+    T& GetMutable(size_t index) {
+        return GetMutableChunk(index / CHUNK_SIZE)[index % CHUNK_SIZE];
+    }
+
+    void push_back(T value) {
+        if (size_ % CHUNK_SIZE == 0) {
+            chunks_.push_back(std::allocate_shared<Chunk>(allocator_, allocator_));
+            chunks_.back()->reserve(CHUNK_SIZE);
+            chunks_.back()->push_back(std::move(value));
+        }
+        else {
+            GetMutableChunk(chunks_.size() - 1).push_back(std::move(value));
+        }
+        ++size_;
+    }
+
+    // Удаляет элементы и освобождает память вектора
+    void clear() {
+        decltype(chunks_)(chunks_.get_allocator()).swap(chunks_);
+        size_ = 0;
+    }
+
+private:
+    using Chunk = std::vector<T, CountingAllocator<T>>;
+
+    CountingAllocator<char> allocator_;
+    std::vector<std::shared_ptr<Chunk>, CountingAllocator<std::shared_ptr<Chunk>>> chunks_;
+    size_t size_ = 0;
+
+    Chunk& GetMutableChunk(size_t index) {
+        std::shared_ptr<Chunk>& chunk = chunks_[index];
+        if (chunk.use_count() > 1) {
+            // Ёмкость части резервируется целиком, чтобы добавление не перемещало элементы
+            auto copy = std::allocate_shared<Chunk>(allocator_, allocator_);
+            copy->reserve(CHUNK_SIZE);
+            copy->assign(chunk->begin(), chunk->end());
+            chunk = std::move(copy);
+        }
+        return *chunk;
+    }
+};
@@ -0,0 +1,128 @@
+#include "snapshot_search_server.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+SnapshotSearchServer::Snapshot::Snapshot(const SnapshotSearchServer* owner, size_t slot, const SearchServer* version) noexcept
+    : owner_(owner)
+    , slot_(slot)
+    , version_(version) {
+}
+
+SnapshotSearchServer::Snapshot::Snapshot(Snapshot&& other) noexcept
+    : owner_(std::exchange(other.owner_, nullptr))
+    , slot_(other.slot_)
+    , version_(std::exchange(other.version_, nullptr)) {
+}
+
+SnapshotSearchServer::Snapshot::~Snapshot() {
+    if (owner_) {
+        owner_->ReleaseSlot(slot_);
+    }
+}
+
+const SearchServer& SnapshotSearchServer::Snapshot::operator*() const noexcept {
+    return *version_;
+}
+
+const SearchServer* SnapshotSearchServer::Snapshot::operator->() const noexcept {
+    return version_;
+}
+
+SnapshotSearchServer::SnapshotSearchServer(SearchServer initial_version)
+    : reader_slots_(READER_SLOT_COUNT)
+    , published_version_(std::make_unique<const SearchServer>(std::move(initial_version))) {
+    current_version_.store(published_version_.get());
+}
+
+SnapshotSearchServer::~SnapshotSearchServer() = default;
+
+SnapshotSearchServer::Snapshot SnapshotSearchServer::Acquire() const {
+    // Слот выбирается по потоку, чтобы потоки не мешали друг другу
+    size_t slot = std::hash<std::thread::id>{}(std::this_thread::get_id()) % READER_SLOT_COUNT;
+    while (true) {
+        bool is_used = false;
+        if (reader_slots_[slot].is_used.compare_exchange_weak(is_used, true)) {
+            break;
+        }
+        slot = (slot + 1) % READER_SLOT_COUNT;
+        if (slot == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Эпоха объявляется до чтения указателя: писатель, не увидевший эпоху,
+    // уже опубликовал новую версию, и читатель получит именно её
+    reader_slots_[slot].epoch.store(global_epoch_.load());
+    return Snapshot(this, slot, current_version_.load());
+}
+
+int SnapshotSearchServer::GetDocumentCount() const {
+    const Snapshot snapshot = Acquire();
+    return snapshot->GetDocumentCount();
+}
+
+void SnapshotSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::lock_guard guard(writer_mutex_);
+    GetNextVersion().AddDocument(document_id, document, status, ratings);
+}
+
+void SnapshotSearchServer::RemoveDocument(int document_id) {
+    std::lock_guard guard(writer_mutex_);
+    GetNextVersion().RemoveDocument(document_id);
+}
+
+void SnapshotSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::lock_guard guard(writer_mutex_);
+    GetNextVersion().RemoveDocuments(document_ids);
+}
+
+void SnapshotSearchServer::Publish() {
+    std::lock_guard guard(writer_mutex_);
+    if (next_version_) {
+        // Публикация — момент заморозки версии: вклады для ранжирования пересчитываются до того,
+        // как версию увидят читатели
+        next_version_->RefreshImpacts();
+        current_version_.store(next_version_.get());
+        const uint64_t retire_epoch = global_epoch_.fetch_add(1) + 1;
+        retired_versions_.push_back({ retire_epoch, std::move(published_version_) });
+        published_version_ = std::move(next_version_);
+    }
+    ReclaimRetiredVersions();
+}
+
+size_t SnapshotSearchServer::GetRetiredVersionCount() const {
+    std::lock_guard guard(writer_mutex_);
+    return retired_versions_.size();
+}
+
+void SnapshotSearchServer::ReleaseSlot(size_t slot) const noexcept {
+    reader_slots_[slot].epoch.store(INACTIVE_EPOCH);
+    reader_slots_[slot].is_used.store(false);
+}
+
+SearchServer& SnapshotSearchServer::GetNextVersion() {
+    if (!next_version_) {
+        next_version_ = std::make_unique<SearchServer>(*published_version_);
+    }
+    return *next_version_;
+}
+
+void SnapshotSearchServer::ReclaimRetiredVersions() {
+    // Версию можно освободить, если все активные читатели вошли в эпоху её замены или позже
+    uint64_t min_active_epoch = UINT64_MAX;
+    for (const ReaderSlot& slot : reader_slots_) {
+        const uint64_t epoch = slot.epoch.load();
+        if (epoch != INACTIVE_EPOCH) {
+            min_active_epoch = std::min(min_active_epoch, epoch);
+        }
+    }
+
+    retired_versions_.erase(
+        std::remove_if(retired_versions_.begin(), retired_versions_.end(),
+            [min_active_epoch](const RetiredVersion& retired) {
+                return retired.epoch <= min_active_epoch;
+            }),
+        retired_versions_.end());
+}
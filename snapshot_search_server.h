@@ -0,0 +1,128 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Поисковый сервер, который можно изменять без остановки запросов.
+ *
+ * Читатели работают с неизменяемой версией индекса и никогда не ждут писателя.
+ * Писатель применяет изменения к своей копии и публикует её вызовом Publish.
+ * Копии разделяют тексты документов и неизменённые блоки словаря, таблицы документов
+ * и списков документов слов, поэтому публикация копирует только указатели на блоки и изменённые блоки.
+ * В режиме RankingMode::IMPACT_ORDERED вклады пересчитываются при каждой публикации целиком.
+ * Старые версии освобождаются, когда их больше не использует ни один читатель
+ * (освобождение по эпохам, epoch-based reclamation).
+ *
+ * Пример использования:
+ *
+ *  SnapshotSearchServer server(SearchServer("and with"s));
+ *  // поток записи
+ *  server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+ *  server.Publish();
+ *  // потоки чтения
+ *  const auto documents = server.FindTopDocuments("cat"s);
+ */
+class SnapshotSearchServer {
+public:
+    // Закреплённая версия индекса: пока объект жив, версия не будет освобождена
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&& other) noexcept;
+        Snapshot& operator=(Snapshot&&) = delete;
+        ~Snapshot();
+
+        const SearchServer& operator*() const noexcept;
+        const SearchServer* operator->() const noexcept;
+
+    private:
+        friend class SnapshotSearchServer;
+
+        Snapshot(const SnapshotSearchServer* owner, size_t slot, const SearchServer* version) noexcept;
+
+        const SnapshotSearchServer* owner_;
+        size_t slot_;
+        const SearchServer* version_;
+    };
+
+    explicit SnapshotSearchServer(SearchServer initial_version);
+
+    SnapshotSearchServer(const SnapshotSearchServer&) = delete;
+    SnapshotSearchServer& operator=(const SnapshotSearchServer&) = delete;
+
+    // Все снимки должны быть освобождены до разрушения сервера
+    ~SnapshotSearchServer();
+
+    Snapshot Acquire() const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+
+    template <typename... Args>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Args&&... args) const;
+
+    int GetDocumentCount() const;
+
+    // Изменения не видны читателям до вызова Publish.
+    // Методы записи можно вызывать из разных потоков, они выполняются по очереди
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Если у сервера выбран режим RankingMode::IMPACT_ORDERED, вклады публикуемой версии пересчитываются
+    void Publish();
+
+    // Заменённые версии, которые ещё не освобождены, потому что их могли закрепить читатели.
+    // Освобождение проверяется при каждом вызове Publish
+    size_t GetRetiredVersionCount() const;
+
+private:
+    static constexpr size_t READER_SLOT_COUNT = 128;
+    // эпоха свободного слота
+    static constexpr uint64_t INACTIVE_EPOCH = 0;
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<bool> is_used = false;
+        std::atomic<uint64_t> epoch = INACTIVE_EPOCH;
+    };
+
+    struct RetiredVersion {
+        uint64_t epoch;
+        std::unique_ptr<const SearchServer> version;
+    };
+
+    mutable std::vector<ReaderSlot> reader_slots_;
+    std::atomic<uint64_t> global_epoch_ = 1;
+    std::atomic<const SearchServer*> current_version_;
+
+    mutable std::mutex writer_mutex_;
+    std::unique_ptr<const SearchServer> published_version_;
+    std::unique_ptr<SearchServer> next_version_;
+    std::vector<RetiredVersion> retired_versions_;
+
+    void ReleaseSlot(size_t slot) const noexcept;
+
+    SearchServer& GetNextVersion();
+
+    void ReclaimRetiredVersions();
+};
+
+template <typename... Args>
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(Args&&... args) const {
+    const Snapshot snapshot = Acquire();
+    return snapshot->FindTopDocuments(std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SnapshotSearchServer::MatchDocument(Args&&... args) const {
+    // Найденные слова ссылаются на запрос, а не на индекс, поэтому их можно вернуть после освобождения снимка
+    const Snapshot snapshot = Acquire();
+    return snapshot->MatchDocument(std::forward<Args>(args)...);
+}
@@ -24,9 +24,16 @@ void FindTopDocuments(const SearchServer& search_server, const std::string& raw_
 void MatchDocuments(const SearchServer& search_server, const std::string& query) {
     try {
         std::cout << "Матчинг документов по запросу: "s << query << std::endl;
-        for (const int document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const MatchedDocuments matched = search_server.MatchDocuments(std::execution::seq, query, search_server);
+        std::vector<std::string_view> words;
+        for (const DocumentMatch& match : matched.matches) {
+            words.clear();
+            for (size_t i = 0; i < matched.plus_words.size(); ++i) {
+                if (match.matched_words & (uint64_t{ 1 } << i)) {
+                    words.push_back(matched.plus_words[i]);
+                }
+            }
+            PrintMatchDocumentResult(match.document_id, words, match.status);
         }
     }
     catch (const std::exception& e) {
@@ -0,0 +1,1218 @@
+#include "tests.h"
+#include "async_search.h"
+#include "concurrent_document_writer.h"
+#include "corpus_generator.h"
+#include "fuzzy_term_index.h"
+#include "paginator.h"
+#include "process_queries.h"
+#include "query_stats.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "search_server.h"
+#include "shared_containers.h"
+#include "sharded_search_server.h"
+#include "snapshot_search_server.h"
+#include "test_framework.h"
+#include "thread_pool.h"
+#include "write_ahead_log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace std;
+
+namespace {
+
+void AssertSameDocuments(const vector<Document>& lhs, const vector<Document>& rhs, const string& hint) {
+    AssertEqual(lhs.size(), rhs.size(), hint);
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        AssertEqual(lhs[i].id, rhs[i].id, hint);
+        Assert(abs(lhs[i].relevance - rhs[i].relevance) < EPSILON, hint);
+        AssertEqual(lhs[i].rating, rhs[i].rating, hint);
+    }
+}
+
+const string TEST_STOP_WORDS = "and in on"s;
+
+// Небольшой корпус с повторяющимися словами: у слов разная частота, у документов — разная длина.
+// add_document вызывается как SearchServer::AddDocument
+template <typename AddDocument>
+void AddTestDocuments(AddDocument add_document) {
+    const vector<string> words = { "cat"s, "dog"s, "bird"s, "fish"s, "curly"s, "fluffy"s, "tail"s, "collar"s, "eyes"s, "nasty"s };
+    for (int id = 0; id < 60; ++id) {
+        string text;
+        for (int i = 0; i <= id % 7; ++i) {
+            text += words[(id * 7 + i * 3) % words.size()] + " "s;
+        }
+        text += "and"s;
+        add_document(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, vector<int>{ id % 9 - 4 });
+    }
+}
+
+SearchServer MakeTestServer(ScoringModel scoring_model = ScoringModel::TF_IDF) {
+    SearchServer search_server(TEST_STOP_WORDS, scoring_model);
+    AddTestDocuments([&search_server](int id, const string& text, DocumentStatus status, const vector<int>& ratings) {
+        search_server.AddDocument(id, text, status, ratings);
+    });
+    return search_server;
+}
+
+const vector<string> TEST_QUERIES = {
+    "cat"s, "curly dog"s, "fluffy -cat"s, "bird fish tail -eyes"s, "nasty collar cat dog"s, "missing"s, "-cat"s,
+};
+
+void TestParallelForCoversEveryIndex() {
+    ThreadPool pool(4);
+    for (const size_t count : { size_t{ 0 }, size_t{ 1 }, size_t{ 7 }, size_t{ 1000 } }) {
+        vector<atomic<int>> visits(count);
+        pool.ParallelFor(count, [&visits](size_t index) {
+            ++visits[index];
+        });
+        for (const atomic<int>& visit_count : visits) {
+            ASSERT_EQUAL(visit_count.load(), 1);
+        }
+    }
+}
+
+void TestParallelForNestedAndExceptions() {
+    ThreadPool pool(3);
+    atomic<int> inner_calls = 0;
+    pool.ParallelFor(8, [&pool, &inner_calls](size_t) {
+        pool.ParallelFor(16, [&inner_calls](size_t) {
+            ++inner_calls;
+        });
+    });
+    ASSERT_EQUAL(inner_calls.load(), 8 * 16);
+
+    ASSERT_THROWS(pool.ParallelFor(100, [](size_t index) {
+        if (index == 42) {
+            throw runtime_error("task failed"s);
+        }
+    }), runtime_error);
+    // После исключения пул продолжает работать
+    atomic<int> calls = 0;
+    pool.ParallelFor(10, [&calls](size_t) {
+        ++calls;
+    });
+    ASSERT_EQUAL(calls.load(), 10);
+}
+
+void TestPoolSearchMatchesSequential() {
+    const SearchServer search_server = MakeTestServer();
+    ThreadPool pool(4);
+    for (const string& query : TEST_QUERIES) {
+        const vector<Document> expected = search_server.FindTopDocuments(execution::seq, query);
+        AssertSameDocuments(search_server.FindTopDocuments(pool, query), expected, query);
+        AssertSameDocuments(search_server.FindTopDocuments(execution::par, query), expected, query);
+    }
+    // Запросы через пул из потоков пула используют свою рабочую память и не мешают друг другу
+    vector<vector<Document>> results(TEST_QUERIES.size());
+    pool.ParallelFor(TEST_QUERIES.size(), [&](size_t index) {
+        results[index] = search_server.FindTopDocuments(pool, TEST_QUERIES[index]);
+    });
+    for (size_t i = 0; i < TEST_QUERIES.size(); ++i) {
+        AssertSameDocuments(results[i], search_server.FindTopDocuments(TEST_QUERIES[i]), TEST_QUERIES[i]);
+    }
+}
+
+// Пока единственный поток пула занят, запросы копятся в очереди и уходят пакетами не больше max_batch_size.
+// Деструктор дожидается всех принятых запросов
+void TestAsyncSearchQueue() {
+    const SearchServer search_server = MakeTestServer();
+    ThreadPool pool(1);
+    const size_t max_batch_size = 4;
+    vector<pair<string, DocumentStatus>> requests;
+    for (const string& query : TEST_QUERIES) {
+        requests.emplace_back(query, DocumentStatus::ACTUAL);
+        requests.emplace_back(query, DocumentStatus::BANNED);
+    }
+
+    // Занимает поток пула, пока не вызван set_value
+    const auto block_pool = [&pool](promise<void>& release) {
+        pool.Submit([gate = release.get_future().share()] {
+            gate.wait();
+        });
+    };
+
+    {
+        AsyncSearchQueue queue(search_server, pool, max_batch_size);
+        promise<void> release;
+        block_pool(release);
+        vector<future<vector<Document>>> results;
+        for (const auto& [query, status] : requests) {
+            results.push_back(queue.FindTopDocuments(query, status));
+        }
+        release.set_value();
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const auto& [query, status] = requests[i];
+            AssertSameDocuments(results[i].get(), search_server.FindTopDocuments(query, status), query);
+        }
+
+        // Пока пул занят, очередь передаёт ему не больше одного пакета, остальные запросы ждут
+        const AsyncSearchStatistics statistics = queue.GetStatistics();
+        ASSERT_EQUAL(statistics.request_count, requests.size());
+        ASSERT_EQUAL(statistics.max_batch_size, max_batch_size);
+        ASSERT(statistics.batch_count >= (requests.size() + max_batch_size - 1) / max_batch_size);
+    }
+
+    vector<future<vector<Document>>> results;
+    {
+        AsyncSearchQueue queue(search_server, pool, max_batch_size);
+        promise<void> release;
+        block_pool(release);
+        for (const auto& [query, status] : requests) {
+            results.push_back(queue.FindTopDocuments(query, status));
+        }
+        release.set_value();
+    }
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const auto& [query, status] = requests[i];
+        Assert(results[i].wait_for(chrono::seconds(0)) == future_status::ready, query);
+        AssertSameDocuments(results[i].get(), search_server.FindTopDocuments(query, status), query);
+    }
+}
+
+// Пакетное сопоставление совпадает с сопоставлением по одному документу: минус-слово обнуляет
+// найденные слова, отсутствующий документ даёт исключение
+void TestMatchDocumentsMatchesMatchDocument() {
+    SearchServer search_server = MakeTestServer();
+    search_server.RemoveDocument(3);
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    const vector<int> removed_ids = { 0, 3 };
+    const vector<int> missing_ids = { 1000 };
+    ThreadPool pool(2);
+
+    const auto check_policy = [&](auto&& policy, const string& policy_name) {
+        for (const string& query : TEST_QUERIES) {
+            const string hint = policy_name + ", query: "s + query;
+            const MatchedDocuments matched = search_server.MatchDocuments(policy, query, document_ids);
+            ASSERT_EQUAL(matched.matches.size(), document_ids.size());
+            for (size_t i = 0; i < document_ids.size(); ++i) {
+                const DocumentMatch& match = matched.matches[i];
+                const auto [expected_words, expected_status] = search_server.MatchDocument(query, document_ids[i]);
+                vector<string_view> words;
+                for (size_t word = 0; word < matched.plus_words.size(); ++word) {
+                    if (match.matched_words & (uint64_t{ 1 } << word)) {
+                        words.push_back(matched.plus_words[word]);
+                    }
+                }
+                AssertEqual(match.document_id, document_ids[i], hint);
+                AssertEqual(static_cast<int>(match.status), static_cast<int>(expected_status), hint);
+                AssertEqual(words, expected_words, hint + ", id: "s + to_string(document_ids[i]));
+            }
+            ASSERT_THROWS(search_server.MatchDocuments(policy, query, removed_ids), out_of_range);
+            ASSERT_THROWS(search_server.MatchDocuments(policy, query, missing_ids), out_of_range);
+        }
+    };
+    check_policy(execution::seq, "seq"s);
+    check_policy(execution::par, "par"s);
+    check_policy(pool, "pool"s);
+
+    // Документы с минус-словом «cat» входят в пакет, но найденных слов у них нет
+    const MatchedDocuments matched = search_server.MatchDocuments(execution::seq, "fluffy -cat"s, document_ids);
+    bool has_excluded = false;
+    for (const DocumentMatch& match : matched.matches) {
+        if (!get<0>(search_server.MatchDocument("cat"s, match.document_id)).empty()) {
+            AssertEqual(match.matched_words, uint64_t{ 0 }, to_string(match.document_id));
+            has_excluded = true;
+        }
+    }
+    ASSERT(has_excluded);
+}
+
+// Упакованные результаты совпадают с ProcessQueries запрос за запросом, в том числе пустые
+// и полные (MAX_RESULT_DOCUMENT_COUNT документов), и при переиспользовании PackedQueryResults
+void TestPackedQueryResultsMatchProcessQueries() {
+    const SearchServer search_server = MakeTestServer();
+    ThreadPool pool(2);
+    vector<string> queries;
+    for (int i = 0; i < 3; ++i) {
+        queries.insert(queries.end(), TEST_QUERIES.begin(), TEST_QUERIES.end());
+    }
+    const vector<vector<Document>> expected = ProcessQueries(search_server, queries);
+    ASSERT(any_of(expected.begin(), expected.end(), [](const vector<Document>& documents) {
+        return documents.empty();
+    }));
+    ASSERT(any_of(expected.begin(), expected.end(), [](const vector<Document>& documents) {
+        return documents.size() == static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT);
+    }));
+
+    const auto check_results = [&](const PackedQueryResults& results, size_t query_count, const string& hint) {
+        ASSERT_EQUAL(results.offsets.size(), query_count + 1);
+        ASSERT_EQUAL(results.offsets.front(), 0u);
+        ASSERT_EQUAL(results.offsets.back(), results.documents.size());
+        for (size_t i = 0; i < query_count; ++i) {
+            const string query_hint = hint + ", query "s + to_string(i) + ": "s + queries[i];
+            AssertEqual(results.offsets[i + 1] - results.offsets[i], expected[i].size(), query_hint);
+            for (size_t j = 0; j < expected[i].size() && results.offsets[i] + j < results.offsets[i + 1]; ++j) {
+                const PackedDocument& document = results.documents[results.offsets[i] + j];
+                AssertEqual(document.id, expected[i][j].id, query_hint);
+                AssertEqual(document.relevance, static_cast<float>(expected[i][j].relevance), query_hint);
+                AssertEqual(document.rating, expected[i][j].rating, query_hint);
+            }
+        }
+    };
+
+    PackedQueryResults results;
+    ProcessQueries(search_server, queries, results);
+    check_results(results, queries.size(), "par"s);
+    PackedQueryResults pool_results;
+    ProcessQueries(pool, search_server, queries, pool_results);
+    check_results(pool_results, queries.size(), "pool"s);
+
+    // Следующий пакет короче, старые результаты в массивах не остаются
+    const vector<string> first_queries(queries.begin(), queries.begin() + TEST_QUERIES.size());
+    ProcessQueries(search_server, first_queries, results);
+    check_results(results, first_queries.size(), "reused par"s);
+    ProcessQueries(pool, search_server, first_queries, pool_results);
+    check_results(pool_results, first_queries.size(), "reused pool"s);
+}
+
+// Сборщик вызывающего потока получает сумму статистик запросов, выполненных потоками-исполнителями
+void TestProcessQueriesCollectsStats() {
+    const SearchServer search_server = MakeTestServer();
+    ThreadPool pool(2);
+    vector<string> queries;
+    for (int i = 0; i < 4; ++i) {
+        queries.insert(queries.end(), TEST_QUERIES.begin(), TEST_QUERIES.end());
+    }
+    QueryStats expected;
+    {
+        QueryStatsCollector collector(expected);
+        for (const string& query : queries) {
+            search_server.FindTopDocuments(query);
+        }
+    }
+    ASSERT_EQUAL(expected.query_count, queries.size());
+    ASSERT(expected.scanned_postings > 0);
+
+    const auto check_stats = [&](const auto& process, const string& hint) {
+        QueryStats stats;
+        {
+            QueryStatsCollector collector(stats);
+            process();
+        }
+        AssertEqual(stats.query_count, expected.query_count, hint);
+        AssertEqual(stats.scanned_postings, expected.scanned_postings, hint);
+    };
+    PackedQueryResults results;
+    check_stats([&] { ProcessQueries(search_server, queries); }, "par"s);
+    check_stats([&] { ProcessQueries(pool, search_server, queries); }, "pool"s);
+    check_stats([&] { ProcessQueries(search_server, queries, results); }, "packed par"s);
+    check_stats([&] { ProcessQueries(pool, search_server, queries, results); }, "packed pool"s);
+}
+
+void TestBudgetedSearch() {
+    // Рейтинг равен id, поэтому порядок документов с равной релевантностью однозначен
+    SearchServer search_server(TEST_STOP_WORDS);
+    for (int id = 0; id < 200; ++id) {
+        search_server.AddDocument(id, id < 3 ? "cat unicorn"s : "cat dog"s, DocumentStatus::ACTUAL, { id });
+    }
+
+    // Без ограничений результат полный и совпадает с обычным поиском
+    for (const string& query : { "unicorn cat"s, "cat -unicorn"s, "dog unicorn"s, "missing"s }) {
+        const BudgetedSearchResult result = search_server.FindTopDocuments(query, SearchBudget{});
+        Assert(!result.is_partial, query);
+        AssertSameDocuments(result.documents, search_server.FindTopDocuments(query), query);
+    }
+
+    // Бюджета хватает только на редкое слово: частое отбрасывается целиком,
+    // и релевантность найденных документов считается только по редкому
+    SearchBudget budget;
+    budget.max_postings = 3;
+    const BudgetedSearchResult partial = search_server.FindTopDocuments("cat unicorn"s, budget);
+    ASSERT(partial.is_partial);
+    AssertSameDocuments(partial.documents, search_server.FindTopDocuments("unicorn"s), "max_postings"s);
+
+    budget.max_postings = 0;
+    const BudgetedSearchResult exhausted = search_server.FindTopDocuments("cat unicorn"s, budget);
+    ASSERT(exhausted.is_partial);
+    ASSERT(exhausted.documents.empty());
+
+    // Истёкший срок останавливает поиск до первого слова
+    budget = SearchBudget{};
+    budget.deadline = chrono::steady_clock::now();
+    const BudgetedSearchResult expired = search_server.FindTopDocuments("cat unicorn"s, budget);
+    ASSERT(expired.is_partial);
+    ASSERT(expired.documents.empty());
+}
+
+// Слово из всех документов имеет нулевой IDF, но документы с ним должны находиться
+void TestWordInEveryDocumentIsFound() {
+    ThreadPool pool(2);
+    for (const ScoringModel scoring_model : { ScoringModel::TF_IDF, ScoringModel::BM25 }) {
+        SearchServer single_document_server("and"s, scoring_model);
+        single_document_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+        for (const string& query : { "cat"s, "cat dog"s, "cat -bird"s }) {
+            const vector<Document> expected = { { 1, single_document_server.FindTopDocuments(query).at(0).relevance, 1 } };
+            AssertSameDocuments(single_document_server.FindTopDocuments(execution::seq, query), expected, query);
+            AssertSameDocuments(single_document_server.FindTopDocuments(execution::par, query), expected, query);
+            AssertSameDocuments(single_document_server.FindTopDocuments(pool, query), expected, query);
+        }
+        ASSERT(single_document_server.FindTopDocuments("cat -dog"s).empty());
+
+        SearchServer search_server("and"s, scoring_model);
+        search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(2, "cat and cat"s, DocumentStatus::ACTUAL, { 5 });
+        search_server.AddDocument(3, "cat bird"s, DocumentStatus::BANNED, { 3 });
+        const vector<Document> cat_documents = search_server.FindTopDocuments("cat"s);
+        ASSERT_EQUAL(cat_documents.size(), 2u);
+        // Релевантность равна нулю, поэтому документы упорядочены по рейтингу
+        ASSERT_EQUAL(cat_documents[0].id, 2);
+        ASSERT_EQUAL(cat_documents[1].id, 1);
+        AssertSameDocuments(search_server.FindTopDocuments(execution::par, "cat"s), cat_documents, "par"s);
+        AssertSameDocuments(search_server.FindTopDocuments(pool, "cat"s), cat_documents, "pool"s);
+        ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, DocumentStatus::BANNED).size(), 1u);
+        // Редкое слово поднимает свой документ выше, а документы частого слова остаются найденными
+        const vector<Document> dog_documents = search_server.FindTopDocuments("cat dog"s);
+        ASSERT_EQUAL(dog_documents.size(), 2u);
+        ASSERT_EQUAL(dog_documents[0].id, 1);
+
+        const QueryExplanation explanation = search_server.ExplainQuery("cat"s);
+        ASSERT_EQUAL(explanation.terms.size(), 1u);
+        ASSERT(!explanation.terms[0].is_dropped);
+
+        SearchServer impact_server = search_server;
+        impact_server.SetRankingMode(RankingMode::IMPACT_ORDERED);
+        AssertSameDocuments(impact_server.FindTopDocuments("cat"s), cat_documents, "impact"s);
+        AssertSameDocuments(impact_server.FindTopDocuments("cat dog"s), dog_documents, "impact"s);
+    }
+}
+
+// Релевантность в шардах считается по статистике всего корпуса, поэтому результаты совпадают с одним сервером
+void TestDuplicateDetectorConfirmsCandidates() {
+    DuplicateDetector detector;
+    DuplicateDetector::Fingerprint fingerprint;
+    fingerprint.words_hash = 42;
+    const auto never_similar = [](int) {
+        return 0.5;
+    };
+    ASSERT(!detector.Add(1, fingerprint, never_similar));
+    // Совпадение хешей без совпадения слов — не дубликат, и документ запоминается как оригинал
+    ASSERT(!detector.Add(2, fingerprint, never_similar));
+    const optional<int> original_id = detector.Add(3, fingerprint, [](int original_id) {
+        return original_id == 2 ? 1.0 : 0.0;
+    });
+    ASSERT(original_id && *original_id == 2);
+}
+
+// Запускает RemoveDuplicates и возвращает id оставшихся документов
+template <typename... Args>
+vector<int> RemoveDuplicatesQuietly(SearchServer& search_server, Args... args) {
+    ostringstream output;
+    streambuf* const cout_buffer = cout.rdbuf(output.rdbuf());
+    RemoveDuplicates(search_server, args...);
+    cout.rdbuf(cout_buffer);
+    return vector<int>(search_server.begin(), search_server.end());
+}
+
+void TestRemoveDuplicates() {
+    string base_text;
+    for (int i = 0; i < 20; ++i) {
+        base_text += "word"s + to_string(i) + " "s;
+    }
+    const auto make_server = [&base_text] {
+        SearchServer search_server(TEST_STOP_WORDS);
+        search_server.AddDocument(1, base_text, DocumentStatus::ACTUAL, { 1 });
+        // то же множество слов в другом порядке, с повторами и стоп-словами
+        search_server.AddDocument(2, "word19 and "s + base_text + "word0"s, DocumentStatus::ACTUAL, { 2 });
+        // 19 общих слов из 21: коэффициент Жаккара около 0.9
+        search_server.AddDocument(3, base_text.substr(0, base_text.rfind("word19"s)) + "other"s, DocumentStatus::ACTUAL, { 3 });
+        // 5 общих слов из 35: коэффициент Жаккара около 0.14
+        search_server.AddDocument(4, "word0 word1 word2 word3 word4 a b c d e f g h i j k l m n o"s, DocumentStatus::ACTUAL, { 4 });
+        search_server.AddDocument(5, "unrelated text"s, DocumentStatus::ACTUAL, { 5 });
+        return search_server;
+    };
+
+    SearchServer exact_server = make_server();
+    ASSERT_EQUAL(RemoveDuplicatesQuietly(exact_server), (vector<int>{ 1, 3, 4, 5 }));
+
+    SearchServer exact_only_server = make_server();
+    ASSERT_EQUAL(RemoveDuplicatesQuietly(exact_only_server, 1.0), (vector<int>{ 1, 3, 4, 5 }));
+
+    SearchServer near_server = make_server();
+    ASSERT_EQUAL(RemoveDuplicatesQuietly(near_server, 0.7), (vector<int>{ 1, 4, 5 }));
+
+    ASSERT(abs(ComputeWordSetSimilarity(exact_server.GetWordFrequencies(1), exact_server.GetWordFrequencies(3)) - 19.0 / 21.0) < EPSILON);
+}
+
+void TestShardedSearchMatchesSingleServer() {
+    const vector<string> queries = { "cat"s, "curly dog"s, "fluffy -cat"s, "bird fish tail -eyes"s, "co*"s, "missing"s };
+    const auto is_even = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    for (const ScoringModel scoring_model : { ScoringModel::TF_IDF, ScoringModel::BM25 }) {
+        for (const size_t shard_count : { size_t{ 1 }, size_t{ 3 }, size_t{ 8 } }) {
+            SearchServer search_server = MakeTestServer(scoring_model);
+            ShardedSearchServer sharded_server(TEST_STOP_WORDS, shard_count, scoring_model);
+            AddTestDocuments([&sharded_server](int id, const string& text, DocumentStatus status, const vector<int>& ratings) {
+                sharded_server.AddDocument(id, text, status, ratings);
+            });
+            ASSERT_EQUAL(sharded_server.GetDocumentCount(), search_server.GetDocumentCount());
+
+            const auto check_queries = [&](const string& stage) {
+                for (const string& query : queries) {
+                    const string hint = stage + ", shards: "s + to_string(shard_count) + ", query: "s + query;
+                    AssertSameDocuments(sharded_server.FindTopDocuments(query), search_server.FindTopDocuments(query), hint);
+                    AssertSameDocuments(sharded_server.FindTopDocuments(execution::par, query), search_server.FindTopDocuments(query), hint);
+                    AssertSameDocuments(sharded_server.FindTopDocuments(execution::seq, query, DocumentStatus::BANNED),
+                        search_server.FindTopDocuments(query, DocumentStatus::BANNED), hint);
+                    AssertSameDocuments(sharded_server.FindTopDocuments(query, is_even), search_server.FindTopDocuments(query, is_even), hint);
+                }
+            };
+            check_queries("initial"s);
+
+            for (const int document_id : { 3, 17, 42, 59 }) {
+                search_server.RemoveDocument(document_id);
+                sharded_server.RemoveDocument(document_id);
+            }
+            check_queries("after removal"s);
+
+            search_server.SetSoftStopWordRatio(0.2);
+            sharded_server.SetSoftStopWordRatio(0.2);
+            check_queries("soft stop words"s);
+        }
+    }
+}
+
+// id с шагом, равным числу шардов, распределяются по всем шардам, а не попадают в один
+void TestShardedSearchSpreadsSteppedIds() {
+    const size_t shard_count = 4;
+    ShardedSearchServer sharded_server(TEST_STOP_WORDS, shard_count);
+    for (int document_id = 0; document_id < 400; document_id += static_cast<int>(shard_count)) {
+        sharded_server.AddDocument(document_id, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        const int shard_document_count = sharded_server.GetShard(i).GetDocumentCount();
+        Assert(shard_document_count > 10 && shard_document_count < 40, "shard "s + to_string(i) + ": "s + to_string(shard_document_count));
+    }
+}
+
+// Потоки попеременно пишут в две очереди: статистика каждой очереди учитывает только её запросы
+void TestRequestQueueCountsRequestsPerQueue() {
+    const SearchServer search_server = MakeTestServer();
+    const size_t thread_count = 4;
+    const size_t request_count = 100;
+    for (int round = 0; round < 2; ++round) {
+        RequestQueue first_queue(search_server);
+        RequestQueue second_queue(search_server);
+        vector<thread> threads;
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads.emplace_back([&] {
+                for (size_t j = 0; j < request_count; ++j) {
+                    first_queue.AddFindRequest("cat"s);
+                    second_queue.AddFindRequest("missing"s);
+                    second_queue.AddFindRequest("dog"s);
+                }
+            });
+        }
+        for (thread& writer : threads) {
+            writer.join();
+        }
+        // Очереди прошлого раунда удалены, новые начинают с нуля
+        ASSERT_EQUAL(first_queue.GetStatistics().request_count, thread_count * request_count);
+        ASSERT_EQUAL(first_queue.GetNoResultRequests(), 0);
+        ASSERT_EQUAL(second_queue.GetStatistics().request_count, 2 * thread_count * request_count);
+        ASSERT_EQUAL(second_queue.GetNoResultRequests(), static_cast<int>(thread_count * request_count));
+    }
+}
+
+// Страницы по курсору покрывают все найденные документы без пропусков и повторов
+void TestCursorPagination() {
+    const SearchServer search_server = MakeTestServer();
+    const size_t all_documents = 1000;
+    const optional<SearchCursor> first_page;
+    for (const string& query : { "cat"s, "curly dog -fish"s, "bird tail eyes"s }) {
+        const SearchPage full_page = search_server.FindTopDocuments(query, all_documents, first_page);
+        ASSERT(full_page.documents.size() > MAX_RESULT_DOCUMENT_COUNT);
+        ASSERT(!full_page.next_cursor);
+        for (size_t i = 1; i < full_page.documents.size(); ++i) {
+            ASSERT(full_page.documents[i - 1].relevance >= full_page.documents[i].relevance - EPSILON);
+        }
+
+        for (const size_t page_size : { size_t{ 1 }, size_t{ 3 }, full_page.documents.size() }) {
+            const string hint = query + ", page size: "s + to_string(page_size);
+            vector<Document> documents;
+            optional<SearchCursor> cursor;
+            do {
+                SearchPage page = search_server.FindTopDocuments(query, page_size, cursor);
+                Assert(!page.documents.empty() && page.documents.size() <= page_size, hint);
+                Assert(!page.next_cursor || page.documents.size() == page_size, hint);
+                documents.insert(documents.end(), page.documents.begin(), page.documents.end());
+                cursor = page.next_cursor;
+            } while (cursor);
+            AssertSameDocuments(documents, full_page.documents, hint);
+
+            vector<Document> lazy_documents;
+            for (const auto& page : PaginateSearch(search_server, query, page_size)) {
+                lazy_documents.insert(lazy_documents.end(), page.begin(), page.end());
+            }
+            AssertSameDocuments(lazy_documents, full_page.documents, hint);
+        }
+    }
+
+    ASSERT(search_server.FindTopDocuments("missing"s, all_documents, first_page).documents.empty());
+    const SearchPage banned_page = search_server.FindTopDocuments("cat"s, all_documents, first_page, DocumentStatus::BANNED);
+    ASSERT(!banned_page.documents.empty());
+    for (const Document& document : banned_page.documents) {
+        ASSERT_EQUAL(document.id % 5, 0);
+    }
+    // Не константа: литерал 0 подошёл бы и как указатель на строку запроса
+    size_t empty_page_size = 0;
+    ASSERT_THROWS(search_server.FindTopDocuments("cat"s, empty_page_size, first_page), invalid_argument);
+}
+
+map<string, double> CollectWordFrequencies(const SearchServer& search_server, int document_id) {
+    map<string, double> word_frequencies;
+    for (const auto [word, frequency] : search_server.GetWordFrequencies(document_id)) {
+        word_frequencies.emplace(word, frequency);
+    }
+    return word_frequencies;
+}
+
+// Прямой индекс по номерам слов: частоты слов документа, освобождение и повторное использование номеров
+void TestTermIdForwardIndex() {
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.AddDocument(1, "curly cat and curly tail"s, DocumentStatus::ACTUAL, { 1 });
+    vector<PreparedDocument> documents;
+    documents.push_back(search_server.PrepareDocument(2, "fluffy cat unique"s, DocumentStatus::ACTUAL, { 2 }));
+    documents.push_back(search_server.PrepareDocument(3, "in on and"s, DocumentStatus::ACTUAL, { 3 }));
+    search_server.AddDocuments(move(documents));
+
+    const map<string, double> first_expected = { { "cat"s, 0.25 }, { "curly"s, 0.5 }, { "tail"s, 0.25 } };
+    ASSERT_EQUAL(CollectWordFrequencies(search_server, 1), first_expected);
+    const map<string, double> second_expected = { { "cat"s, 1.0 / 3 }, { "fluffy"s, 1.0 / 3 }, { "unique"s, 1.0 / 3 } };
+    ASSERT_EQUAL(CollectWordFrequencies(search_server, 2), second_expected);
+    ASSERT(CollectWordFrequencies(search_server, 3).empty());
+    ASSERT(CollectWordFrequencies(search_server, 42).empty());
+
+    // Копия разделяет индекс с исходным сервером, но её изменения исходный сервер не видит
+    SearchServer copy = search_server;
+    copy.RemoveDocument(2);
+    copy.AddDocument(4, "curly unique dog"s, DocumentStatus::ACTUAL, { 4 });
+    ASSERT_EQUAL(CollectWordFrequencies(search_server, 2), second_expected);
+    ASSERT(CollectWordFrequencies(search_server, 4).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("unique"s).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("unique"s).at(0).id, 2);
+    ASSERT_EQUAL(copy.FindTopDocuments("unique"s).at(0).id, 4);
+
+    // После удаления последнего документа со словом оно уходит из словаря, а его номер достаётся новым словам
+    search_server.RemoveDocument(2);
+    ASSERT(search_server.FindTopDocuments("unique"s).empty());
+    ASSERT(search_server.FindTopDocuments("un*"s).empty());
+    ASSERT(search_server.ExplainQuery("fluffy"s).terms.at(0).is_dropped);
+    search_server.AddDocument(5, "nasty bird"s, DocumentStatus::ACTUAL, { 5 });
+    search_server.AddDocument(6, "nasty collar"s, DocumentStatus::ACTUAL, { 6 });
+    const map<string, double> fifth_expected = { { "bird"s, 0.5 }, { "nasty"s, 0.5 } };
+    ASSERT_EQUAL(CollectWordFrequencies(search_server, 5), fifth_expected);
+    ASSERT_EQUAL(CollectWordFrequencies(search_server, 1), first_expected);
+    const string query = "nasty fluffy tail"s;
+    const auto [words, status] = search_server.MatchDocument(query, 6);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "nasty"sv);
+    ASSERT_EQUAL(search_server.FindTopDocuments("nasty"s).size(), 2u);
+}
+
+// Досрочная остановка по вкладам находит те же лучшие документы с той же релевантностью, что и полный перебор
+void TestImpactOrderedMatchesExhaustive() {
+    CorpusOptions corpus_options;
+    corpus_options.document_count = 3000;
+    corpus_options.vocabulary_size = 2000;
+    QueryOptions query_options;
+    query_options.query_count = 300;
+    const SyntheticCorpus corpus = GenerateCorpus(corpus_options);
+    const vector<string> queries = GenerateQueries(corpus, corpus_options, query_options);
+    const auto has_odd_id = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 1;
+    };
+
+    for (const ScoringModel scoring_model : { ScoringModel::TF_IDF, ScoringModel::BM25 }) {
+        SearchServer search_server(corpus.stop_words, scoring_model);
+        for (const SyntheticDocument& document : corpus.documents) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        SearchServer impact_server = search_server;
+        impact_server.SetRankingMode(RankingMode::IMPACT_ORDERED);
+
+        // Порядок документов с равными релевантностью и рейтингом не задан, поэтому сравниваются
+        // релевантности и рейтинги по местам, а каждый найденный документ сверяется с полным перебором
+        const auto check_ranking = [&search_server](const vector<Document>& documents, const string& query,
+            auto document_predicate, const string& hint) {
+            const vector<Document> expected = search_server.FindTopDocuments(query, document_predicate);
+            const SearchPage all_matches = search_server.FindTopDocuments(query, search_server.GetDocumentCount() + size_t{ 1 },
+                optional<SearchCursor>{}, document_predicate);
+            AssertEqual(documents.size(), expected.size(), hint);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                Assert(abs(documents[i].relevance - expected[i].relevance) < EPSILON, hint);
+                AssertEqual(documents[i].rating, expected[i].rating, hint);
+                const auto it = find_if(all_matches.documents.begin(), all_matches.documents.end(),
+                    [&documents, i](const Document& document) {
+                        return document.id == documents[i].id;
+                });
+                Assert(it != all_matches.documents.end() && abs(it->relevance - documents[i].relevance) < EPSILON, hint);
+            }
+        };
+        const auto is_banned = [](int, DocumentStatus status, int) {
+            return status == DocumentStatus::BANNED;
+        };
+        const auto is_actual = [](int, DocumentStatus status, int) {
+            return status == DocumentStatus::ACTUAL;
+        };
+
+        const auto check_queries = [&](const string& stage) {
+            QueryStats stats;
+            {
+                QueryStatsCollector collector(stats);
+                for (const string& query : queries) {
+                    const string hint = stage + ", query: "s + query;
+                    check_ranking(impact_server.FindTopDocuments(query), query, is_actual, hint);
+                    check_ranking(impact_server.FindTopDocuments(query, DocumentStatus::BANNED), query, is_banned, hint);
+                    check_ranking(impact_server.FindTopDocuments(query, has_odd_id), query, has_odd_id, hint);
+                }
+            }
+            // Поиск по вкладам действительно останавливался досрочно
+            Assert(stats.skipped_postings > 0, stage);
+        };
+        check_queries("initial"s);
+
+        vector<int> removed_ids;
+        for (size_t i = 0; i < corpus.documents.size(); i += 7) {
+            removed_ids.push_back(corpus.documents[i].id);
+        }
+        search_server.RemoveDocuments(removed_ids);
+        impact_server.RemoveDocuments(removed_ids);
+        impact_server.RefreshImpacts();
+        check_queries("after removal"s);
+    }
+}
+
+// Префикс раскрывается не больше чем в заданное число слов словаря по алфавиту
+void TestPrefixExpansionBound() {
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.AddDocument(1, "cat catalog dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "category bird"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "car dog"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(4, "fish"s, DocumentStatus::ACTUAL, { 4 });
+
+    ASSERT_EQUAL(search_server.GetMaxPrefixExpansions(), SearchServer::DEFAULT_MAX_PREFIX_EXPANSIONS);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat*"s).size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("ca*"s).size(), 3u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("ca* -catal*"s).size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments(execution::par, "ca* -catal*"s).size(), 2u);
+    ASSERT(search_server.FindTopDocuments("zz*"s).empty());
+    // Звёздочка внутри слова — обычный символ
+    ASSERT(search_server.FindTopDocuments("c*t"s).empty());
+
+    QueryStats stats;
+    {
+        QueryStatsCollector collector(stats);
+        search_server.FindTopDocuments("cat* -bird"s);
+    }
+    ASSERT_EQUAL(stats.expanded_terms, 3u);
+
+    // Из "ca*" остаётся только первое по алфавиту слово "car"
+    search_server.SetMaxPrefixExpansions(1);
+    const vector<Document> bounded = search_server.FindTopDocuments("ca*"s);
+    ASSERT_EQUAL(bounded.size(), 1u);
+    ASSERT_EQUAL(bounded[0].id, 3);
+    search_server.SetMaxPrefixExpansions(2);
+    ASSERT_EQUAL(search_server.FindTopDocuments("ca*"s).size(), 2u);
+    search_server.SetMaxPrefixExpansions(0);
+    ASSERT(search_server.FindTopDocuments("ca*"s).empty());
+    search_server.SetMaxPrefixExpansions(SearchServer::DEFAULT_MAX_PREFIX_EXPANSIONS);
+
+    ASSERT_THROWS(search_server.FindTopDocuments("*"s), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("-*"s), invalid_argument);
+
+    search_server.RemoveDocument(2);
+    ASSERT(search_server.FindTopDocuments("catego*"s).empty());
+}
+
+// Расстояние Дамерау — Левенштейна (с перестановками соседних символов) полной таблицей
+int ComputeEditDistanceNaive(const string& lhs, const string& rhs) {
+    vector<vector<int>> distances(lhs.size() + 1, vector<int>(rhs.size() + 1));
+    for (size_t i = 0; i <= lhs.size(); ++i) {
+        distances[i][0] = static_cast<int>(i);
+    }
+    for (size_t j = 0; j <= rhs.size(); ++j) {
+        distances[0][j] = static_cast<int>(j);
+    }
+    for (size_t i = 1; i <= lhs.size(); ++i) {
+        for (size_t j = 1; j <= rhs.size(); ++j) {
+            distances[i][j] = min({ distances[i - 1][j] + 1, distances[i][j - 1] + 1, distances[i - 1][j - 1] + (lhs[i - 1] != rhs[j - 1]) });
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1]) {
+                distances[i][j] = min(distances[i][j], distances[i - 2][j - 2] + 1);
+            }
+        }
+    }
+    return distances[lhs.size()][rhs.size()];
+}
+
+string MakeRandomWord(mt19937& generator, size_t max_size, char last_letter) {
+    string word(1 + generator() % max_size, 'a');
+    for (char& c : word) {
+        c = static_cast<char>('a' + generator() % (last_letter - 'a' + 1));
+    }
+    return word;
+}
+
+// Индекс удалений находит все слова на допустимом расстоянии, а расстояние совпадает с полной таблицей
+void TestFuzzyTermIndex() {
+    mt19937 generator(1);
+    for (int i = 0; i < 20000; ++i) {
+        const string lhs = MakeRandomWord(generator, 6, 'c');
+        const string rhs = MakeRandomWord(generator, 6, 'c');
+        const int max_distance = 1 + static_cast<int>(generator() % 2);
+        AssertEqual(ComputeEditDistance(lhs, rhs, max_distance), min(ComputeEditDistanceNaive(lhs, rhs), max_distance + 1), lhs + " "s + rhs);
+    }
+
+    for (const int max_distance : { 1, 2 }) {
+        const auto counter = make_shared<MemoryCounter>(0);
+        FuzzyTermIndex index(max_distance, CountingAllocator<char>(counter));
+        vector<string> words;
+        for (uint32_t term_id = 0; term_id < 400; ++term_id) {
+            words.push_back(MakeRandomWord(generator, 6, 'd'));
+            index.AddTerm(term_id, words.back());
+        }
+        ASSERT(counter->load() > 0);
+        for (uint32_t term_id = 0; term_id < 200; ++term_id) {
+            index.RemoveTerm(term_id, words[term_id]);
+        }
+        for (int i = 0; i < 200; ++i) {
+            const string word = MakeRandomWord(generator, 6, 'd');
+            vector<uint32_t> term_ids;
+            index.FindCandidates(word, term_ids);
+            const set<uint32_t> candidates(term_ids.begin(), term_ids.end());
+            for (uint32_t term_id = 200; term_id < words.size(); ++term_id) {
+                if (ComputeEditDistanceNaive(word, words[term_id]) <= max_distance) {
+                    Assert(candidates.count(term_id) > 0, word + " "s + words[term_id]);
+                }
+            }
+            Assert(candidates.empty() || *candidates.begin() >= 200, word);
+        }
+    }
+}
+
+void TestFuzzySearch() {
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "cart dog"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(4, "fish"s, DocumentStatus::ACTUAL, { 4 });
+    ASSERT(search_server.FindTopDocuments("crly"s).empty());
+
+    search_server.SetFuzzySearch(FuzzySearchOptions{});
+    // Расстояние 1: удаление, перестановка соседних символов; точное совпадение весит больше исправленного
+    const vector<Document> curly = search_server.FindTopDocuments("crly"s);
+    ASSERT_EQUAL(curly.size(), 1u);
+    ASSERT_EQUAL(curly[0].id, 1);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cta"s).at(0).id, 1);
+    const vector<Document> cat = search_server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(cat.size(), 2u);
+    ASSERT_EQUAL(cat[0].id, 1);
+    ASSERT_EQUAL(cat[1].id, 3);
+    ASSERT_EQUAL(search_server.FindTopDocuments(execution::par, "cat"s).size(), 2u);
+    // Расстояние 2 при пределе 1 — промах
+    ASSERT(search_server.FindTopDocuments("crl"s).empty());
+    ASSERT(search_server.FindTopDocuments("flfy"s).empty());
+    // Минус-слова ищутся точно
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat -dgo"s).size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat -dog"s).size(), 1u);
+
+    const string query = "crly fsh"s;
+    const auto [words, status] = search_server.MatchDocument(query, 1);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "curly"sv);
+
+    // Новые слова попадают в индекс удалений сразу, удалённые — исчезают
+    search_server.AddDocument(5, "zebra"s, DocumentStatus::ACTUAL, { 5 });
+    ASSERT_EQUAL(search_server.FindTopDocuments("zebar"s).size(), 1u);
+    search_server.RemoveDocument(5);
+    ASSERT(search_server.FindTopDocuments("zebar"s).empty());
+    {
+        SearchServer copy = search_server;
+        copy.AddDocument(6, "zebra"s, DocumentStatus::ACTUAL, { 6 });
+        ASSERT_EQUAL(copy.FindTopDocuments("zebr"s).size(), 1u);
+        ASSERT(search_server.FindTopDocuments("zebr"s).empty());
+    }
+
+    QueryStats stats;
+    {
+        QueryStatsCollector collector(stats);
+        search_server.FindTopDocuments("crly dgo"s);
+    }
+    ASSERT_EQUAL(stats.fuzzy_terms, 2u);
+
+    // Расстояние 2: "crl" находит curly и cart (через "cat"), "crlyy" — curly
+    search_server.SetFuzzySearch(FuzzySearchOptions{ 2, 8, 0.5 });
+    ASSERT_EQUAL(search_server.FindTopDocuments("crl"s).size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("crlyy"s).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("flfy"s).at(0).id, 2);
+    ASSERT(search_server.FindTopDocuments("abcde"s).empty());
+    ASSERT(search_server.GetMemoryStatistics().fuzzy_index_bytes > 0);
+
+    ASSERT_THROWS(search_server.SetFuzzySearch(FuzzySearchOptions{ 3, 8, 0.5 }), invalid_argument);
+    ASSERT_THROWS(search_server.SetFuzzySearch(FuzzySearchOptions{ 1, 8, 0.0 }), invalid_argument);
+    search_server.SetFuzzySearch(nullopt);
+    ASSERT(search_server.FindTopDocuments("crly"s).empty());
+    ASSERT_EQUAL(search_server.GetMemoryStatistics().fuzzy_index_bytes, 0u);
+}
+
+// Документы, которые сервер не принял, остаются отложенными до следующего Flush
+void TestConcurrentWriterKeepsDocumentsOnFailedFlush() {
+    SearchServer search_server(TEST_STOP_WORDS);
+    ConcurrentDocumentWriter writer(search_server);
+    writer.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+    writer.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, { 2 });
+
+    search_server.SetMemoryBudget(size_t{ 1 });
+    ASSERT_EQUAL(writer.Flush(), 0u);
+    search_server.SetMemoryBudget(nullopt);
+
+    // Документ с тем же id, добавленный в обход писателя, не даёт серверу принять пакет
+    search_server.AddDocument(2, "nasty bird"s, DocumentStatus::ACTUAL, { 3 });
+    ASSERT_THROWS(writer.Flush(), invalid_argument);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+
+    search_server.RemoveDocument(2);
+    ASSERT_EQUAL(writer.Flush(), 2u);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat dog"s).size(), 2u);
+    ASSERT_EQUAL(writer.Flush(), 0u);
+}
+
+// Журнал из трёх добавлений и удаления; возвращает размеры файла после каждой записи
+vector<uintmax_t> WriteTestLog(const string& path) {
+    filesystem::remove(path);
+    SearchServer search_server(TEST_STOP_WORDS);
+    WriteAheadLog log(search_server, path, LogDurability::EVERY_RECORD);
+    vector<uintmax_t> sizes;
+    log.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    sizes.push_back(filesystem::file_size(path));
+    log.AddDocument(2, "fluffy dog and collar"s, DocumentStatus::BANNED, {});
+    sizes.push_back(filesystem::file_size(path));
+    log.RemoveDocument(1);
+    sizes.push_back(filesystem::file_size(path));
+    log.AddDocument(3, "nasty cat"s, DocumentStatus::ACTUAL, { -3 });
+    sizes.push_back(filesystem::file_size(path));
+    return sizes;
+}
+
+void TestWriteAheadLogReplay() {
+    const string path = (filesystem::temp_directory_path() / "search_server_test.wal").string();
+    WriteTestLog(path);
+
+    SearchServer search_server(TEST_STOP_WORDS);
+    WriteAheadLog log(search_server, path);
+    ASSERT_EQUAL(log.GetReplayedRecordCount(), 4u);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).at(0).id, 3);
+    ASSERT_EQUAL(search_server.FindTopDocuments("dog"s, DocumentStatus::BANNED).size(), 1u);
+    filesystem::remove(path);
+}
+
+void TestWriteAheadLogDropsTruncatedRecord() {
+    const string path = (filesystem::temp_directory_path() / "search_server_test.wal").string();
+    const vector<uintmax_t> sizes = WriteTestLog(path);
+    // Последняя запись оборвана на середине
+    filesystem::resize_file(path, (sizes[2] + sizes[3]) / 2);
+    {
+        SearchServer search_server(TEST_STOP_WORDS);
+        WriteAheadLog log(search_server, path);
+        ASSERT_EQUAL(log.GetReplayedRecordCount(), 3u);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+        ASSERT(search_server.FindTopDocuments("cat"s).empty());
+        // Оборванная запись отрезана, новые записи дописываются после последней целой
+        ASSERT_EQUAL(filesystem::file_size(path), sizes[2]);
+        log.AddDocument(4, "curly bird"s, DocumentStatus::ACTUAL, { 5 });
+    }
+    SearchServer search_server(TEST_STOP_WORDS);
+    WriteAheadLog log(search_server, path);
+    ASSERT_EQUAL(log.GetReplayedRecordCount(), 4u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("bird"s).size(), 1u);
+    filesystem::remove(path);
+}
+
+void TestWriteAheadLogStopsAtCorruptRecord() {
+    const string path = (filesystem::temp_directory_path() / "search_server_test.wal").string();
+    const vector<uintmax_t> sizes = WriteTestLog(path);
+    {
+        // Последний байт второй записи — символ текста документа: контрольная сумма перестаёт сходиться
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(static_cast<streamoff>(sizes[1] - 1));
+        file.put('x');
+    }
+    SearchServer search_server(TEST_STOP_WORDS);
+    WriteAheadLog log(search_server, path);
+    // Записи после повреждённой не воспроизводятся
+    ASSERT_EQUAL(log.GetReplayedRecordCount(), 1u);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).at(0).id, 1);
+    ASSERT_EQUAL(filesystem::file_size(path), sizes[0]);
+    filesystem::remove(path);
+}
+
+// Изменение, отклонённое сервером, не попадает в журнал и не воспроизводится
+void TestWriteAheadLogSkipsRejectedChanges() {
+    const string path = (filesystem::temp_directory_path() / "search_server_test.wal").string();
+    filesystem::remove(path);
+    {
+        SearchServer search_server(TEST_STOP_WORDS);
+        WriteAheadLog log(search_server, path, LogDurability::EVERY_RECORD);
+        log.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+        const uintmax_t log_size = filesystem::file_size(path);
+
+        search_server.SetMemoryBudget(size_t{ 1 });
+        ASSERT_THROWS(log.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, { 2 }), MemoryBudgetExceeded);
+        ASSERT_THROWS(log.AddDocument(1, "nasty cat"s, DocumentStatus::ACTUAL, { 3 }), invalid_argument);
+        ASSERT_EQUAL(filesystem::file_size(path), log_size);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+
+        search_server.SetMemoryBudget(nullopt);
+        log.AddDocument(3, "fluffy bird"s, DocumentStatus::ACTUAL, { 4 });
+    }
+    SearchServer search_server(TEST_STOP_WORDS);
+    WriteAheadLog log(search_server, path);
+    ASSERT_EQUAL(log.GetReplayedRecordCount(), 2u);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    ASSERT(search_server.FindTopDocuments("dog"s).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("bird"s).size(), 1u);
+    filesystem::remove(path);
+}
+
+// Ограничение размера файла обрывает запись на середине: write записывает часть байтов, а затем завершается ошибкой
+void TestWriteAheadLogDiscardsTornAppend() {
+    const string path = (filesystem::temp_directory_path() / "search_server_test.wal").string();
+    filesystem::remove(path);
+    {
+        SearchServer search_server(TEST_STOP_WORDS);
+        WriteAheadLog log(search_server, path, LogDurability::EVERY_RECORD);
+        log.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+        const uintmax_t log_size = filesystem::file_size(path);
+
+        rlimit file_size_limit{};
+        getrlimit(RLIMIT_FSIZE, &file_size_limit);
+        const rlimit torn_limit{ static_cast<rlim_t>(log_size + 10), file_size_limit.rlim_max };
+        const auto previous_handler = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &torn_limit);
+        bool is_thrown = false;
+        try {
+            log.AddDocument(2, "fluffy dog with a long collar"s, DocumentStatus::ACTUAL, { 2 });
+        }
+        catch (const system_error&) {
+            is_thrown = true;
+        }
+        setrlimit(RLIMIT_FSIZE, &file_size_limit);
+        signal(SIGXFSZ, previous_handler);
+
+        ASSERT(is_thrown);
+        ASSERT_EQUAL(filesystem::file_size(path), log_size);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+        log.AddDocument(3, "fluffy bird"s, DocumentStatus::ACTUAL, { 4 });
+    }
+    // Запись после неудачной воспроизводится
+    SearchServer search_server(TEST_STOP_WORDS);
+    WriteAheadLog log(search_server, path);
+    ASSERT_EQUAL(log.GetReplayedRecordCount(), 2u);
+    ASSERT(search_server.FindTopDocuments("dog"s).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("bird"s).size(), 1u);
+    filesystem::remove(path);
+}
+
+// Случайные добавления и удаления в нескольких копиях словаря сравниваются с копиями std::map:
+// изменение одной копии не должно быть видно в других
+void TestSharedSortedMapMatchesMap() {
+    auto counter = make_shared<MemoryCounter>(0);
+    const CountingAllocator<char> allocator(counter);
+    mt19937 generator(7);
+    vector<SharedSortedMap<int, int>> maps{ SharedSortedMap<int, int>(allocator) };
+    vector<map<int, int>> expected_maps(1);
+    for (int step = 0; step < 20000; ++step) {
+        if (step % 2000 == 0 && maps.size() < 5) {
+            const size_t source = generator() % maps.size();
+            maps.push_back(maps[source]);
+            expected_maps.push_back(expected_maps[source]);
+        }
+        const size_t index = generator() % maps.size();
+        // Ключи чаще идут по возрастанию, как id документов, но добавляются и в середину
+        const int key = generator() % 3 == 0 ? static_cast<int>(generator() % 5000) : step;
+        if (generator() % 3 == 0) {
+            ASSERT_EQUAL(maps[index].erase(key), expected_maps[index].erase(key));
+        }
+        else {
+            ASSERT_EQUAL(maps[index].emplace(key, step), expected_maps[index].emplace(key, step).second);
+        }
+    }
+
+    for (size_t i = 0; i < maps.size(); ++i) {
+        ASSERT_EQUAL(maps[i].size(), expected_maps[i].size());
+        ASSERT_EQUAL((map<int, int>(maps[i].begin(), maps[i].end())), expected_maps[i]);
+        vector<int> expected_keys;
+        for (const auto& [key, _] : expected_maps[i]) {
+            expected_keys.push_back(key);
+        }
+        ASSERT_EQUAL(vector<int>(maps[i].key_begin(), maps[i].key_end()), expected_keys);
+        for (int key = -1; key <= 20001; key += 7) {
+            const auto it = maps[i].lower_bound(key);
+            const auto expected_it = expected_maps[i].lower_bound(key);
+            ASSERT_EQUAL(it == maps[i].end(), expected_it == expected_maps[i].end());
+            if (expected_it != expected_maps[i].end()) {
+                ASSERT_EQUAL(it->first, expected_it->first);
+            }
+            ASSERT_EQUAL(maps[i].count(key), expected_maps[i].count(key));
+        }
+    }
+    // Общие блоки освобождаются вместе с последней копией
+    maps.clear();
+    ASSERT_EQUAL(counter->load(), 0u);
+}
+
+void TestSharedChunkedVectorCopyOnWrite() {
+    auto counter = make_shared<MemoryCounter>(0);
+    SharedChunkedVector<int> numbers{ CountingAllocator<char>(counter) };
+    for (int i = 0; i < 1000; ++i) {
+        numbers.push_back(i);
+    }
+    SharedChunkedVector<int> copy = numbers;
+    const int* const shared_element = &numbers[10];
+    copy.GetMutable(10) = -10;
+    copy.push_back(1000);
+    ASSERT_EQUAL(numbers[10], 10);
+    ASSERT_EQUAL(copy[10], -10);
+    ASSERT_EQUAL(numbers.size(), 1000u);
+    ASSERT_EQUAL(copy.size(), 1001u);
+    ASSERT_EQUAL(copy[1000], 1000);
+    // Исходный вектор больше не разделяет изменённую часть и меняет её на месте
+    numbers.GetMutable(10) = 11;
+    ASSERT_EQUAL(&numbers[10], shared_element);
+    ASSERT_EQUAL(copy[10], -10);
+    copy.clear();
+    ASSERT(copy.empty());
+}
+
+// Писатель добавляет документы парами и публикует каждую пару, читатели в это время проверяют,
+// что видят только целые пары и что версии не откатываются назад
+void TestSnapshotConcurrentIngestion() {
+    const int pair_count = 300;
+    for (const size_t reader_count : { size_t{ 1 }, size_t{ 8 }, size_t{ 64 } }) {
+        SnapshotSearchServer server(SearchServer("and"s));
+        atomic<bool> is_writing = true;
+        atomic<size_t> inconsistency_count = 0;
+        atomic<size_t> checked_snapshot_count = 0;
+
+        vector<thread> readers;
+        for (size_t i = 0; i < reader_count; ++i) {
+            readers.emplace_back([&] {
+                int last_document_count = 0;
+                do {
+                    const SnapshotSearchServer::Snapshot snapshot = server.Acquire();
+                    const int document_count = snapshot->GetDocumentCount();
+                    bool is_consistent = document_count % 2 == 0 && document_count >= last_document_count;
+                    if (document_count > 0) {
+                        const string last_pair = "pair"s + to_string(document_count / 2 - 1);
+                        is_consistent = is_consistent && snapshot->FindTopDocuments(last_pair).size() == 2;
+                    }
+                    const string next_pair = "pair"s + to_string(document_count / 2);
+                    is_consistent = is_consistent && snapshot->FindTopDocuments(next_pair).empty();
+                    inconsistency_count += !is_consistent;
+                    ++checked_snapshot_count;
+                    last_document_count = document_count;
+                } while (is_writing.load());
+            });
+        }
+
+        for (int pair = 0; pair < pair_count; ++pair) {
+            const string text = "common pair"s + to_string(pair);
+            server.AddDocument(2 * pair, text, DocumentStatus::ACTUAL, { 1 });
+            server.AddDocument(2 * pair + 1, text + " tail"s, DocumentStatus::ACTUAL, { 2 });
+            server.Publish();
+        }
+        is_writing = false;
+        for (thread& reader : readers) {
+            reader.join();
+        }
+
+        const string hint = "readers: "s + to_string(reader_count);
+        AssertEqual(inconsistency_count.load(), size_t{ 0 }, hint);
+        Assert(checked_snapshot_count.load() >= reader_count, hint);
+        AssertEqual(server.GetDocumentCount(), 2 * pair_count, hint);
+        // Без читателей все заменённые версии освобождаются при следующей публикации
+        server.Publish();
+        AssertEqual(server.GetRetiredVersionCount(), size_t{ 0 }, hint);
+    }
+}
+
+void TestSnapshotPinsRetiredVersion() {
+    SnapshotSearchServer server(SearchServer("and"s));
+    server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.Publish();
+    {
+        const SnapshotSearchServer::Snapshot snapshot = server.Acquire();
+        server.RemoveDocument(1);
+        server.Publish();
+        server.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, { 1 });
+        server.Publish();
+        // Закреплённая версия не освобождается и по-прежнему видит удалённый документ
+        ASSERT(server.GetRetiredVersionCount() >= 1u);
+        ASSERT_EQUAL(snapshot->FindTopDocuments("cat"s).size(), 1u);
+        ASSERT(server.FindTopDocuments("cat"s).empty());
+    }
+    server.Publish();
+    ASSERT_EQUAL(server.GetRetiredVersionCount(), 0u);
+    ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 1u);
+}
+
+} // namespace
+
+void RunTests() {
+    TestRunner tr;
+    RUN_TEST(tr, TestParallelForCoversEveryIndex);
+    RUN_TEST(tr, TestParallelForNestedAndExceptions);
+    RUN_TEST(tr, TestPoolSearchMatchesSequential);
+    RUN_TEST(tr, TestAsyncSearchQueue);
+    RUN_TEST(tr, TestMatchDocumentsMatchesMatchDocument);
+    RUN_TEST(tr, TestPackedQueryResultsMatchProcessQueries);
+    RUN_TEST(tr, TestProcessQueriesCollectsStats);
+    RUN_TEST(tr, TestBudgetedSearch);
+    RUN_TEST(tr, TestWordInEveryDocumentIsFound);
+    RUN_TEST(tr, TestDuplicateDetectorConfirmsCandidates);
+    RUN_TEST(tr, TestRemoveDuplicates);
+    RUN_TEST(tr, TestShardedSearchMatchesSingleServer);
+    RUN_TEST(tr, TestShardedSearchSpreadsSteppedIds);
+    RUN_TEST(tr, TestRequestQueueCountsRequestsPerQueue);
+    RUN_TEST(tr, TestTermIdForwardIndex);
+    RUN_TEST(tr, TestPrefixExpansionBound);
+    RUN_TEST(tr, TestFuzzyTermIndex);
+    RUN_TEST(tr, TestFuzzySearch);
+    RUN_TEST(tr, TestConcurrentWriterKeepsDocumentsOnFailedFlush);
+    RUN_TEST(tr, TestImpactOrderedMatchesExhaustive);
+    RUN_TEST(tr, TestCursorPagination);
+    RUN_TEST(tr, TestWriteAheadLogReplay);
+    RUN_TEST(tr, TestWriteAheadLogDropsTruncatedRecord);
+    RUN_TEST(tr, TestWriteAheadLogStopsAtCorruptRecord);
+    RUN_TEST(tr, TestWriteAheadLogSkipsRejectedChanges);
+    RUN_TEST(tr, TestWriteAheadLogDiscardsTornAppend);
+    RUN_TEST(tr, TestSharedSortedMapMatchesMap);
+    RUN_TEST(tr, TestSharedChunkedVectorCopyOnWrite);
+    RUN_TEST(tr, TestSnapshotConcurrentIngestion);
+    RUN_TEST(tr, TestSnapshotPinsRetiredVersion);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Запускает модульные тесты. При провале печатает имена проваленных тестов и завершает программу с кодом 1
+void RunTests();
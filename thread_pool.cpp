@@ -0,0 +1,133 @@
+#include "thread_pool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker_index = 0;
+
+void PinCurrentThread(size_t cpu_index) {
+#ifdef __linux__
+    const size_t cpu_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu_index % cpu_count, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+    (void)cpu_index;
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count, bool pin_threads) {
+    thread_count = std::max<size_t>(1, thread_count);
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i, pin_threads] { WorkerLoop(i, pin_threads); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(wake_mutex_);
+        stop_ = true;
+    }
+    wake_condition_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const noexcept {
+    return workers_.size();
+}
+
+size_t ThreadPool::GetCurrentWorkerIndex() const noexcept {
+    return current_pool == this ? current_worker_index : GetThreadCount();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    size_t index = GetCurrentWorkerIndex();
+    if (index == GetThreadCount()) {
+        index = next_worker_.fetch_add(1) % GetThreadCount();
+    }
+    // Счётчик растёт до публикации задачи: иначе забравший её исполнитель уменьшил бы счётчик раньше,
+    // чем тот учёл задачу
+    {
+        std::lock_guard guard(wake_mutex_);
+        ++pending_tasks_;
+    }
+    {
+        std::lock_guard guard(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    wake_condition_.notify_one();
+}
+
+void ThreadPool::WorkerLoop(size_t index, bool pin_thread) {
+    current_pool = this;
+    current_worker_index = index;
+    if (pin_thread) {
+        PinCurrentThread(index);
+    }
+
+    std::function<void()> task;
+    while (true) {
+        if (TryPopTask(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock lock(wake_mutex_);
+        wake_condition_.wait(lock, [this] { return stop_ || pending_tasks_ > 0; });
+        if (stop_ && pending_tasks_ == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryPopTask(size_t index, std::function<void()>& task) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --pending_tasks_;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers_.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --pending_tasks_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::RunPendingTask() {
+    const size_t index = GetCurrentWorkerIndex();
+    if (index == GetThreadCount()) {
+        return false;
+    }
+    std::function<void()> task;
+    if (!TryPopTask(index, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Пул потоков с перехватом задач (work stealing).
+ *
+ * У каждого потока-исполнителя своя очередь задач: свои задачи поток берёт
+ * с конца очереди, чужие — «ворует» с начала. Исполнитель, ожидающий завершения
+ * ParallelFor, сам выполняет задачи из очередей, поэтому вложенный параллелизм
+ * не создаёт лишних потоков. Когда задач нет, ожидающий поток, в том числе внешний,
+ * засыпает до завершения последней части и не занимает ядро.
+ *
+ * Пример использования:
+ *
+ *  ThreadPool pool(4);
+ *  search_server.FindTopDocuments(pool, "curly cat"s);
+ *  ProcessQueries(pool, search_server, queries);
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency(), bool pin_threads = false);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    size_t GetThreadCount() const noexcept;
+
+    // Номер текущего потока в пуле, для внешних потоков — GetThreadCount().
+    // Позволяет заводить по одному буферу на исполнителя без синхронизации
+    size_t GetCurrentWorkerIndex() const noexcept;
+
+    void Submit(std::function<void()> task);
+
+    // Вызывает function(index) для каждого index из [0, count) и дожидается завершения.
+    // Вызывающий поток участвует в обработке наравне с исполнителями
+    template <typename Function>
+    void ParallelFor(size_t count, Function function);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_worker_ = 0;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_condition_;
+    std::atomic<size_t> pending_tasks_ = 0;
+    bool stop_ = false;
+
+    void WorkerLoop(size_t index, bool pin_thread);
+
+    bool TryPopTask(size_t index, std::function<void()>& task);
+
+    // Выполняет одну задачу из очередей пула, если вызван из потока пула
+    bool RunPendingTask();
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t count, Function function) {
+    if (count == 0) {
+        return;
+    }
+
+    struct State {
+        std::atomic<size_t> next_index = 0;
+        std::atomic<size_t> done_count = 0;
+        std::mutex exception_mutex;
+        std::exception_ptr exception;
+        std::mutex done_mutex;
+        std::condition_variable done_condition;
+    };
+
+    auto state = std::make_shared<State>();
+    const size_t grain_size = std::max<size_t>(1, count / ((GetThreadCount() + 1) * 4));
+    const size_t chunk_count = (count + grain_size - 1) / grain_size;
+
+    // Задачи-помощники могут начать работу уже после выхода из ParallelFor.
+    // К function они обращаются, только захватив ещё не обработанный индекс,
+    // а такое возможно лишь пока вызывающий поток ждёт завершения
+    auto process_chunks = [state, count, grain_size, function_ptr = &function]() {
+        for (size_t first = state->next_index.fetch_add(grain_size); first < count;
+             first = state->next_index.fetch_add(grain_size)) {
+            const size_t last = std::min(first + grain_size, count);
+            try {
+                for (size_t index = first; index < last; ++index) {
+                    (*function_ptr)(index);
+                }
+            }
+            catch (...) {
+                std::lock_guard guard(state->exception_mutex);
+                if (!state->exception) {
+                    state->exception = std::current_exception();
+                }
+            }
+            if (state->done_count.fetch_add(last - first) + (last - first) == count) {
+                // Под мьютексом, чтобы ожидающий поток не пропустил уведомление между проверкой и засыпанием
+                std::lock_guard guard(state->done_mutex);
+                state->done_condition.notify_all();
+            }
+        }
+    };
+
+    const size_t helper_count = std::min(GetThreadCount(), chunk_count - 1);
+    for (size_t i = 0; i < helper_count; ++i) {
+        Submit(process_chunks);
+    }
+
+    process_chunks();
+
+    // Все части уже разобраны, и незавершённые выполняются другими потоками прямо сейчас,
+    // поэтому сон до их завершения не приводит к взаимной блокировке
+    while (state->done_count.load() < count) {
+        if (RunPendingTask()) {
+            continue;
+        }
+        std::unique_lock lock(state->done_mutex);
+        state->done_condition.wait(lock, [&state, count] { return state->done_count.load() >= count; });
+    }
+
+    if (state->exception) {
+        std::rethrow_exception(state->exception);
+    }
+}
@@ -0,0 +1,268 @@
+#include "write_ahead_log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Запись журнала: размер данных, контрольная сумма данных, данные.
+// Числа хранятся в порядке байтов машины, журнал не переносится между платформами
+constexpr size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+uint32_t ComputeChecksum(std::string_view data) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char c : data) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+template <typename Value>
+void WriteValue(std::string& out, Value value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Читает значение из начала data. Возвращает false, если данных не хватает
+template <typename Value>
+bool ReadValue(std::string_view& data, Value& value) {
+    if (data.size() < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, data.data(), sizeof(value));
+    data.remove_prefix(sizeof(value));
+    return true;
+}
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(SearchServer& search_server, const std::string& path, LogDurability durability, size_t group_size)
+    : search_server_(search_server)
+    , durability_(durability)
+    , group_size_(std::max<size_t>(1, group_size)) {
+    log_size_ = Replay(path);
+
+    file_descriptor_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (file_descriptor_ < 0) {
+        ThrowSystemError("не удалось открыть журнал");
+    }
+    // Отбрасывается недописанная при сбое запись
+    if (ftruncate(file_descriptor_, static_cast<off_t>(log_size_)) != 0) {
+        const int error = errno;
+        close(file_descriptor_);
+        throw std::system_error(error, std::generic_category(), "не удалось обрезать журнал");
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (unsynced_record_count_ > 0 && durability_ != LogDurability::NONE) {
+        fsync(file_descriptor_);
+    }
+    close(file_descriptor_);
+}
+
+void WriteAheadLog::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    // Документ проверяется до записи, чтобы в журнал не попадали изменения, которые нельзя применить
+    PreparedDocument prepared = search_server_.PrepareDocument(document_id, document, status, ratings);
+    if (search_server_.IsMemoryBudgetExceeded()) {
+        throw MemoryBudgetExceeded("память индекса превышает заданный предел");
+    }
+
+    record_.assign(RECORD_HEADER_SIZE, '\0');
+    WriteValue(record_, RecordType::ADD_DOCUMENT);
+    WriteValue(record_, static_cast<int32_t>(document_id));
+    WriteValue(record_, static_cast<int32_t>(status));
+    WriteValue(record_, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        WriteValue(record_, static_cast<int32_t>(rating));
+    }
+    WriteValue(record_, static_cast<uint32_t>(document.size()));
+    record_.append(document);
+    const size_t record_offset = log_size_;
+    AppendRecord();
+
+    std::vector<PreparedDocument> documents;
+    documents.push_back(std::move(prepared));
+    try {
+        search_server_.AddDocuments(std::move(documents));
+    }
+    catch (...) {
+        // Изменение, которое сервер не принял, не должно воспроизводиться при открытии журнала
+        DiscardRecords(record_offset);
+        throw;
+    }
+}
+
+void WriteAheadLog::RemoveDocument(int document_id) {
+    record_.assign(RECORD_HEADER_SIZE, '\0');
+    WriteValue(record_, RecordType::REMOVE_DOCUMENT);
+    WriteValue(record_, static_cast<int32_t>(document_id));
+    const size_t record_offset = log_size_;
+    AppendRecord();
+
+    try {
+        search_server_.RemoveDocument(document_id);
+    }
+    catch (...) {
+        DiscardRecords(record_offset);
+        throw;
+    }
+}
+
+void WriteAheadLog::Sync() {
+    if (unsynced_record_count_ == 0) {
+        return;
+    }
+    if (fsync(file_descriptor_) != 0) {
+        ThrowSystemError("не удалось записать журнал на диск");
+    }
+    unsynced_record_count_ = 0;
+}
+
+void WriteAheadLog::Clear() {
+    if (ftruncate(file_descriptor_, 0) != 0 || fsync(file_descriptor_) != 0) {
+        ThrowSystemError("не удалось очистить журнал");
+    }
+    unsynced_record_count_ = 0;
+    log_size_ = 0;
+}
+
+size_t WriteAheadLog::GetReplayedRecordCount() const noexcept {
+    return replayed_record_count_;
+}
+
+size_t WriteAheadLog::Replay(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        return 0;
+    }
+    const std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+    // Подряд идущие добавления и удаления применяются пакетами
+    std::vector<PreparedDocument> added_documents;
+    std::vector<int> removed_ids;
+    const auto apply_added = [&] {
+        if (!added_documents.empty()) {
+            search_server_.AddDocuments(std::execution::par, std::move(added_documents));
+            added_documents.clear();
+        }
+    };
+    const auto apply_removed = [&] {
+        if (!removed_ids.empty()) {
+            search_server_.RemoveDocuments(std::execution::par, removed_ids);
+            removed_ids.clear();
+        }
+    };
+
+    std::string_view rest = content;
+    size_t valid_size = 0;
+    while (true) {
+        uint32_t size = 0;
+        uint32_t checksum = 0;
+        if (!ReadValue(rest, size) || !ReadValue(rest, checksum) || rest.size() < size) {
+            break;
+        }
+        std::string_view payload = rest.substr(0, size);
+        if (ComputeChecksum(payload) != checksum) {
+            break;
+        }
+        rest.remove_prefix(size);
+
+        RecordType type{};
+        int32_t document_id = 0;
+        if (!ReadValue(payload, type) || !ReadValue(payload, document_id)) {
+            break;
+        }
+        if (type == RecordType::ADD_DOCUMENT) {
+            int32_t status = 0;
+            uint32_t rating_count = 0;
+            if (!ReadValue(payload, status) || !ReadValue(payload, rating_count)) {
+                break;
+            }
+            std::vector<int> ratings(rating_count);
+            bool is_complete = true;
+            for (int& rating : ratings) {
+                int32_t value = 0;
+                is_complete = is_complete && ReadValue(payload, value);
+                rating = value;
+            }
+            uint32_t text_size = 0;
+            if (!is_complete || !ReadValue(payload, text_size) || payload.size() != text_size) {
+                break;
+            }
+            apply_removed();
+            added_documents.push_back(search_server_.PrepareDocument(document_id, payload, static_cast<DocumentStatus>(status), ratings));
+        }
+        else if (type == RecordType::REMOVE_DOCUMENT) {
+            apply_added();
+            removed_ids.push_back(document_id);
+        }
+        else {
+            break;
+        }
+
+        valid_size = content.size() - rest.size();
+        ++replayed_record_count_;
+    }
+
+    apply_added();
+    apply_removed();
+    return valid_size;
+}
+
+void WriteAheadLog::AppendRecord() {
+    const uint32_t size = static_cast<uint32_t>(record_.size() - RECORD_HEADER_SIZE);
+    const uint32_t checksum = ComputeChecksum(std::string_view(record_).substr(RECORD_HEADER_SIZE));
+    std::memcpy(record_.data(), &size, sizeof(size));
+    std::memcpy(record_.data() + sizeof(size), &checksum, sizeof(checksum));
+
+    // Запись целиком передаётся одним вызовом, чтобы при сбое оборвалась только она
+    const size_t record_offset = log_size_;
+    const char* data = record_.data();
+    size_t remaining = record_.size();
+    try {
+        while (remaining > 0) {
+            const ssize_t written = write(file_descriptor_, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ThrowSystemError("не удалось дописать журнал");
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+
+        log_size_ += record_.size();
+        ++unsynced_record_count_;
+        if (durability_ == LogDurability::EVERY_RECORD
+            || (durability_ == LogDurability::GROUP && unsynced_record_count_ >= group_size_)) {
+            Sync();
+        }
+    }
+    catch (...) {
+        // Оборванная запись остановила бы воспроизведение, и все следующие записи потерялись бы
+        DiscardRecords(record_offset);
+        throw;
+    }
+}
+
+void WriteAheadLog::DiscardRecords(size_t offset) {
+    // Обрезанный журнал сбрасывается на диск, иначе после сбоя отброшенная запись могла бы вернуться
+    if (ftruncate(file_descriptor_, static_cast<off_t>(offset)) != 0
+        || (durability_ != LogDurability::NONE && fsync(file_descriptor_) != 0)) {
+        ThrowSystemError("не удалось отбросить запись журнала");
+    }
+    log_size_ = offset;
+    unsynced_record_count_ = 0;
+}
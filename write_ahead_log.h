@@ -0,0 +1,81 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class LogDurability {
+    // записи остаются в буферах ОС, при сбое системы теряются последние изменения
+    NONE,
+    // журнал сбрасывается на диск раз в group_size записей и при вызове Sync
+    GROUP,
+    // каждое изменение сбрасывается на диск до возврата из метода
+    EVERY_RECORD
+};
+
+/**
+ * Журнал упреждающей записи (write-ahead log) изменений поискового сервера.
+ *
+ * AddDocument и RemoveDocument проверяют изменение, записывают его в двоичный журнал
+ * и только затем применяют к серверу. Если сервер не принял изменение, запись отбрасывается. При создании журнал воспроизводит сохранённые
+ * записи поверх переданного сервера пакетными методами AddDocuments и RemoveDocuments.
+ * Недописанная при сбое последняя запись отбрасывается.
+ *
+ * Журнал должен содержать только изменения, сделанные после получения базового
+ * состояния сервера. После сохранения нового базового состояния журнал очищается методом Clear.
+ *
+ * Пример использования:
+ *
+ *  SearchServer search_server("and with"s);
+ *  WriteAheadLog log(search_server, "index.wal"s, LogDurability::GROUP);
+ *  log.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+ *  log.RemoveDocument(1);
+ */
+class WriteAheadLog {
+public:
+    WriteAheadLog(SearchServer& search_server, const std::string& path, LogDurability durability = LogDurability::GROUP, size_t group_size = 64);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog();
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    // Сбрасывает на диск все записанные изменения
+    void Sync();
+
+    void Clear();
+
+    // Число записей, воспроизведённых при открытии журнала
+    size_t GetReplayedRecordCount() const noexcept;
+
+private:
+    enum class RecordType : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2
+    };
+
+    SearchServer& search_server_;
+    const LogDurability durability_;
+    const size_t group_size_;
+    int file_descriptor_ = -1;
+    size_t unsynced_record_count_ = 0;
+    size_t replayed_record_count_ = 0;
+    // размер корректной части файла журнала
+    size_t log_size_ = 0;
+    std::string record_;
+
+    // Воспроизводит журнал и возвращает размер его корректной части
+    size_t Replay(const std::string& path);
+
+    void AppendRecord();
+
+    // Обрезает журнал до offset байт, отбрасывая записи после этой позиции
+    void DiscardRecords(size_t offset);
+};